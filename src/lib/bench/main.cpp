@@ -0,0 +1,291 @@
+#include "../src/edid.hpp"
+#include "../src/modes.hpp"
+#include "../src/x11.hpp"
+#include <algorithm>
+#include <chrono>
+#include <dman/config.hpp>
+#include <dman/digest.hpp>
+#include <dman/display.hpp>
+#include <dman/edid.hpp>
+#include <fcntl.h>
+#include <iostream>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Prints one JSON object per benchmark and line, so runs from two commits
+// can be compared with any line-oriented tool. An optional argument only
+// runs the benchmarks whose name starts with it; a second one is the dman
+// binary the startup benchmark runs, by default the one built alongside.
+
+static std::string filter;
+
+template <typename T> static void keep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+template <typename F>
+static void run(const std::string &name, size_t size, F &&body)
+{
+    if (!name.starts_with(filter))
+        return;
+
+    using clock = std::chrono::steady_clock;
+    constexpr auto min_batch_time = std::chrono::milliseconds(50);
+    constexpr int batches = 7;
+
+    // Grow the batch until it is long enough to time reliably.
+    size_t iterations = 1;
+    while (true)
+    {
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            body();
+        if (clock::now() - start >= min_batch_time)
+            break;
+        iterations *= 2;
+    }
+
+    std::vector<double> ns_per_op;
+    for (int batch = 0; batch < batches; ++batch)
+    {
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            body();
+        std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+        ns_per_op.push_back(elapsed.count() / iterations);
+    }
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+
+    std::cout << "{\"name\":\"" << name << "\",\"size\":" << size
+              << ",\"iterations\":" << iterations
+              << ",\"min_ns\":" << ns_per_op.front()
+              << ",\"median_ns\":" << ns_per_op[batches / 2] << "}"
+              << std::endl;
+}
+
+static std::vector<uint8_t> synthetic_edid(uint32_t serial)
+{
+    std::vector<uint8_t> edid(256);
+    const uint8_t header[8] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+    std::copy(header, header + 8, edid.begin());
+    edid[8] = 0x10; // "DEL"
+    edid[9] = 0xAC;
+    edid[10] = 0x34;
+    edid[11] = 0x12;
+    std::copy((uint8_t *)&serial, (uint8_t *)&serial + 4, edid.begin() + 12);
+    for (size_t i = 16; i < edid.size(); ++i)
+        edid[i] = (uint8_t)(i * 31 + serial);
+    return edid;
+}
+
+static std::string synthetic_config(size_t outputs)
+{
+    std::string text;
+    for (size_t i = 0; i < outputs; ++i)
+    {
+        std::vector<uint8_t> edid = synthetic_edid(i);
+        text += digest::sha256(edid.data(), edid.size()).hex();
+        text += " x=" + std::to_string(i % 8 * 1920);
+        text += " y=" + std::to_string(i / 8 % 4 * 1080);
+        text += " width=1920 height=1080 rate=59.950172";
+        text += " name=DEL-1234-" + std::to_string(i);
+        text += i % 3 ? " rotation=normal" : " rotation=left";
+        if (i == 0)
+            text += " primary";
+        text += " tearfree=on\n";
+    }
+    return text;
+}
+
+// A snapshot with `outputs` outputs, each offering the same `count`
+// distinct modes.
+static x11::snapshot synthetic_snapshot(size_t count, size_t outputs = 1)
+{
+    x11::snapshot snapshot;
+    x11::snapshot::output output{.id = 1, .name = "DP-1"};
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        unsigned int width = 640 + 8 * i;
+        unsigned int height = 480 + 4 * i;
+        unsigned int h_total = width + 160;
+        unsigned int v_total = height + 45;
+        RRMode id = 0x100 + i;
+
+        snapshot.add_mode(
+            x11::snapshot::mode{
+                .id = id,
+                .width = width,
+                .height = height,
+                .dot_clock = 60ul * h_total * v_total,
+                .h_total = h_total,
+                .v_total = v_total,
+            },
+            std::to_string(width) + "x" + std::to_string(height));
+        output.modes.push_back(id);
+    }
+
+    for (size_t i = 0; i < outputs; ++i)
+    {
+        output.edid = synthetic_edid(i);
+        snapshot.outputs.push_back(output);
+        output.id++;
+        output.name = "DP-" + std::to_string(output.id);
+    }
+    snapshot.index_modes();
+    return snapshot;
+}
+
+static void bench_config()
+{
+    for (size_t size : {1, 10, 100, 1000, 10000})
+    {
+        std::string text = synthetic_config(size);
+        run("config.parse", size, [&] {
+            util::display::config config(text);
+            keep(config);
+        });
+
+        util::display::config config(text);
+        std::string out;
+        run("config.serialize", size, [&] {
+            out.clear();
+            config.serialize(out);
+            keep(out);
+        });
+
+        util::display::config half(synthetic_config(size / 2));
+        run("config.set_reference", size, [&] {
+            half.set_reference(config);
+            keep(half);
+        });
+    }
+}
+
+static void bench_edid()
+{
+    std::vector<uint8_t> raw = synthetic_edid(42);
+    run("edid.construct", raw.size(), [&] {
+        display::edid edid(raw.data(), raw.size());
+        keep(edid);
+    });
+    run("edid.decode_cached", raw.size(), [&] {
+        keep(edids::decode(raw).digest);
+    });
+    run("edid.preferred_timing", raw.size(), [&] {
+        display::edid_view view(raw.data(), raw.size());
+        keep(view.preferred_timing());
+    });
+}
+
+static void bench_sha256()
+{
+    for (size_t size : {128, 256, 4096})
+    {
+        std::vector<uint8_t> data(size, 0xA5);
+        run("sha256.hash", size, [&] {
+            digest::sha256 digest(data.data(), data.size());
+            keep(digest);
+        });
+    }
+
+    digest::sha256 digest(std::string("dman"));
+    run("sha256.hex", 32, [&] {
+        std::string hex = digest.hex();
+        keep(hex);
+    });
+    run("sha256.parse_hex", 64, [&, hex = digest.hex()] {
+        std::optional<digest::sha256> parsed = digest::sha256::parse_hex(hex);
+        keep(parsed);
+    });
+}
+
+static void bench_modes()
+{
+    for (size_t size : {16, 128, 512})
+    {
+        x11::snapshot snapshot = synthetic_snapshot(size);
+        const x11::snapshot::output &output = snapshot.outputs.front();
+
+        std::vector<display::mode> modes;
+        for (const x11::snapshot::mode &mode : snapshot.modes)
+            modes.push_back(modes::calc_mode_from_info(snapshot, mode));
+
+        // The last mode is the worst case for a linear search.
+        display::mode target = modes.back();
+
+        run("modes.get_mode_index", size, [&] {
+            uint32_t index = modes::get_mode_index(modes, target);
+            keep(index);
+        });
+        run("modes.find_mode_id_by_info", size, [&] {
+            RRMode id = modes::find_mode_id_by_info(snapshot, output, target);
+            keep(id);
+        });
+    }
+
+    x11::snapshot snapshot = synthetic_snapshot(150, 12);
+    run("snapshot.copy", snapshot.modes.size(), [&] {
+        x11::snapshot copy = snapshot;
+        keep(copy);
+    });
+    run("snapshot.index_modes", snapshot.modes.size(), [&] {
+        snapshot.index_modes();
+        keep(snapshot);
+    });
+}
+
+static void bench_outputs()
+{
+    x11::snapshot snapshot = synthetic_snapshot(150, 12);
+    display::output_snapshot outputs;
+
+    run("outputs.to_output", snapshot.outputs.size(), [&] {
+        std::pmr::vector<display::output> &result = outputs.reset();
+        for (const x11::snapshot::output &info : snapshot.outputs)
+            x11::to_output(snapshot, info, result.emplace_back());
+        keep(result);
+    });
+}
+
+// Starting dman and having it exit at once is dominated by loading and
+// relocating the libraries it links.
+static void bench_startup(const char *path)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(
+        &actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    char *const arguments[] = {(char *)path, (char *)"--help", nullptr};
+
+    run("startup.help", 0, [&] {
+        pid_t pid;
+        int status;
+        if (posix_spawn(&pid, path, &actions, nullptr, arguments, environ) == 0)
+            waitpid(pid, &status, 0);
+    });
+
+    posix_spawn_file_actions_destroy(&actions);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        filter = argv[1];
+
+    const char *dman_path = argc > 2 ? argv[2] : DMAN_PATH;
+
+    bench_config();
+    bench_edid();
+    bench_sha256();
+    bench_modes();
+    bench_outputs();
+    bench_startup(dman_path);
+
+    return 0;
+}
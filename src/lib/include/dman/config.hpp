@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstdint>
+#include <dman/digest.hpp>
+#include <optional>
+#include <span>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace display
@@ -15,19 +20,28 @@ namespace util::display
 {
 struct config
 {
-    std::unordered_map<std::string, ::display::state> outputs;
-    std::unordered_map<std::string, std::string> name_to_edid;
-    std::unordered_map<std::string, std::string> edid_to_name;
-    void associate_name_edid(const std::string &name, const std::string &edid);
+    digest::map<::display::state> outputs;
+    std::unordered_map<std::string, digest::sha256> name_to_edid;
+    digest::map<std::string> edid_to_name;
+    void associate_name_edid(const std::string &name,
+                             const digest::sha256 &edid);
 
   public:
-    std::string get_edid(const std::string &id) const;
-    std::string get_name(const std::string &id) const;
-    config(const std::vector<::display::output> &outputs);
-    config(const std::string &config_text);
+    // Resolves a configured name, or else an EDID hash in hex.
+    std::optional<digest::sha256> get_edid(const std::string &id) const;
+    std::string get_name(const digest::sha256 &edid) const;
+    config(std::span<const ::display::output> outputs);
+    // Throws common::parse_error naming the line and column of bad input.
+    config(std::string_view config_text);
+    // Only decodes the lines whose EDID hash is wanted; the others are
+    // skipped as soon as their leading hash has been read.
+    config(std::string_view config_text, const digest::set &wanted);
     void set_reference(const util::display::config &other);
+    // Appends the active outputs in the config file format, sorted by EDID
+    // hash, reusing whatever capacity `out` already has.
+    void serialize(std::string &out) const;
     operator std::string() const;
-    operator const std::unordered_map<std::string, ::display::state> &() const
+    operator const digest::map<::display::state> &() const
     {
         return outputs;
     }
@@ -36,6 +50,40 @@ struct config
     void enable_output(const std::string &name);
     void disable_output(const std::string &name);
 };
+
+// Many layouts, each keyed by the set of EDIDs it expects to be connected.
+// A saved store is memory-mapped and only the profile that is looked up
+// gets parsed.
+class profiles
+{
+    std::unordered_map<std::string, std::string> added;
+    const uint8_t *mapped = nullptr;
+    size_t mapped_size = 0;
+
+    const std::string *find_added(const std::string &key) const;
+    std::optional<std::string> find_mapped(const std::string &key) const;
+    std::optional<std::string> find(const std::string &key) const;
+
+  public:
+    profiles() {};
+    explicit profiles(const std::string &path);
+    ~profiles();
+
+    profiles(const profiles &) = delete;
+    profiles &operator=(const profiles &) = delete;
+
+    // The lookup key for a set of EDID hashes, in any order.
+    static std::string key(std::vector<digest::sha256> edids);
+
+    // Throws for a profile with no outputs.
+    void add(const config &profile);
+    void save(const std::string &path) const;
+
+    // The profile for exactly these EDIDs, or failing that the largest one
+    // whose EDIDs are all among them.
+    std::optional<config>
+    match(const std::vector<digest::sha256> &edids) const;
+};
 } // namespace util::display
 
 namespace util::tablet {
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstring>
+#include <optional>
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace digest
 {
@@ -12,10 +17,69 @@ class sha256
 
   public:
     sha256(const void *begin, size_t size);
-    sha256(const std::string & input);
-    sha256() {};
+    explicit sha256(const std::string &input);
+    sha256() : content{} {};
+
+    // Parses the 64 character form produced by hex(), in either case.
+    static std::optional<sha256> parse_hex(std::string_view hex);
+    static sha256 from_hex(std::string_view hex);
+
     std::string hex() const;
+    // Writes the 64 hex characters to `out` and returns the end.
+    char *hex(char *out) const;
+    const uint8_t *data() const
+    {
+        return content;
+    }
     bool operator==(const sha256 &other) const;
-    bool operator==(const std::string &hex_str) const;
+    bool operator==(std::string_view hex_str) const;
+    bool operator<(const sha256 &other) const;
+};
+
+// Hashing and equality for sha256 keys that also accept the hex form, so
+// containers keyed by digests can be searched with text straight from a
+// file without converting it first.
+struct hash
+{
+    using is_transparent = void;
+
+    size_t operator()(const sha256 &digest) const
+    {
+        // The digest is already uniformly distributed.
+        size_t result;
+        std::memcpy(&result, digest.data(), sizeof(result));
+        return result;
+    }
+    size_t operator()(std::string_view hex) const
+    {
+        std::optional<sha256> digest = sha256::parse_hex(hex);
+        return digest ? (*this)(*digest) : 0;
+    }
+};
+
+struct equal_to
+{
+    using is_transparent = void;
+
+    bool operator()(const sha256 &a, const sha256 &b) const
+    {
+        return a == b;
+    }
+    bool operator()(const sha256 &a, std::string_view b) const
+    {
+        return a == b;
+    }
+    bool operator()(std::string_view a, const sha256 &b) const
+    {
+        return b == a;
+    }
+};
+
+template <typename T> using map = std::unordered_map<sha256, T, hash, equal_to>;
+using set = std::unordered_set<sha256, hash, equal_to>;
+
+} // namespace digest
+
+template <> struct std::hash<digest::sha256> : digest::hash
+{
 };
-} // namespace digest
\ No newline at end of file
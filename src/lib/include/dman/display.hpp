@@ -1,18 +1,85 @@
 #pragma once
 
+#include <compare>
 #include <cstdint>
 #include <dman/digest.hpp>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
 #include <vector>
 #include <unordered_map>
 
 namespace display
 {
+// A refresh rate in Hz as a fraction, so rates a double would round
+// together, such as 59.94 and 59.9401 Hz, still order and compare exactly.
+struct rational_rate
+{
+    uint64_t numerator = 0;
+    uint64_t denominator = 1;
+
+    // The nearest fraction with a denominator of 1000, for rates only
+    // known as a double.
+    static rational_rate from(double rate);
+
+    double value() const;
+    std::strong_ordering operator<=>(const rational_rate &other) const;
+    bool operator==(const rational_rate &other) const
+    {
+        return (*this <=> other) == 0;
+    }
+};
+
+// The exact timing a mode is driven with. Modes of one size can differ only
+// in this, such as 144 Hz and 143.9 Hz panels.
+struct timing
+{
+    uint64_t dot_clock = 0;
+    uint32_t h_total = 0;
+    uint32_t v_total = 0;
+    uint32_t flags = 0;
+
+    // The refresh rate, exactly as the timing gives it.
+    rational_rate exact_rate() const;
+    double rate() const
+    {
+        return exact_rate().value();
+    }
+    bool empty() const
+    {
+        return dot_clock == 0;
+    }
+    bool operator==(const timing &other) const = default;
+};
+
+// Modes, EDIDs and outputs allocate from whatever resource the container
+// they're put in was given, so an output_snapshot holds all of them in its
+// arena. Plain copies allocate from the heap as usual.
+using allocator = std::pmr::polymorphic_allocator<>;
+
 struct mode
 {
-    std::string name;
+    using allocator_type = allocator;
+
+    std::pmr::string name;
     unsigned int width;
     unsigned int height;
     double rate;
+    // Empty for modes read from configs written before timings were saved.
+    struct timing timing;
+
+    mode() = default;
+    explicit mode(const allocator_type &alloc);
+    mode(const mode &other, const allocator_type &alloc);
+    mode(mode &&other, const allocator_type &alloc);
+    mode(const mode &) = default;
+    mode(mode &&) = default;
+    mode &operator=(const mode &) = default;
+    mode &operator=(mode &&) = default;
+
     bool operator==(const mode &other) const;
 };
 
@@ -23,14 +90,23 @@ struct config;
 
 struct edid
 {
+    using allocator_type = allocator;
+
     digest::sha256 digest;
-    std::vector<uint8_t> raw;
-    std::string manufacturer_id;
-    std::string manufacturer_product_code;
-    std::string serial_number;
-    std::string name;
+    std::pmr::vector<uint8_t> raw;
+    std::pmr::string manufacturer_id;
+    std::pmr::string manufacturer_product_code;
+    std::pmr::string serial_number;
+    std::pmr::string name;
     edid() {};
-    edid(const void *data, size_t size);
+    edid(const void *data, size_t size, const allocator_type &alloc = {});
+    explicit edid(const allocator_type &alloc);
+    edid(const edid &other, const allocator_type &alloc);
+    edid(edid &&other, const allocator_type &alloc);
+    edid(const edid &) = default;
+    edid(edid &&) = default;
+    edid &operator=(const edid &) = default;
+    edid &operator=(edid &&) = default;
 };
 enum class rotation : uint8_t
 {
@@ -76,21 +152,110 @@ struct state
 class output
 {
   public:
-    std::string name;
-    std::vector<mode> modes;
+    using allocator_type = allocator;
+
+    std::pmr::string name;
+    std::pmr::vector<mode> modes;
     vec2<unsigned int> position;
     uint32_t mode_index = 0;
     bool is_primary = false;
     bool is_active = false;
+    // Whether a display is attached that the EDID digest identifies, even
+    // when the digest was made up from what the compositor says about it.
+    bool is_connected = false;
     tearfree is_tearfree = tearfree::UNSET;
     enum rotation rotation;
     class edid edid;
+
+    output() = default;
+    explicit output(const allocator_type &alloc);
+    output(const output &other, const allocator_type &alloc);
+    output(output &&other, const allocator_type &alloc);
+    output(const output &) = default;
+    output(output &&) = default;
+    output &operator=(const output &) = default;
+    output &operator=(output &&) = default;
+
     void operator=(const mode &mode);
     void operator=(const state &state);
     operator state() const;
 };
 
+// Outputs from one probe, allocated with everything they hold from one
+// arena instead of a few allocations each. Resetting frees them all at
+// once and keeps the arena, grown to fit them, for the next probe, so a
+// long-running caller stops allocating once it has seen its largest
+// layout. Outputs kept past a reset must be copied out, not moved.
+class output_snapshot
+{
+    struct arena;
+    std::unique_ptr<arena> mem;
+
+  public:
+    output_snapshot();
+    ~output_snapshot();
+
+    output_snapshot(const output_snapshot &) = delete;
+    output_snapshot &operator=(const output_snapshot &) = delete;
+
+    // Drops the outputs and returns the empty list for the next ones.
+    std::pmr::vector<output> &reset();
+    std::span<const output> outputs() const;
+};
+
+// One connection to the display server and the outputs it reported, shared
+// by every query and apply of an operation so the server is only probed
+// once. Applying marks the outputs stale; they're probed again the next
+// time they're asked for.
+class context
+{
+    struct session;
+    std::unique_ptr<session> sess;
+
+  public:
+    context();
+    ~context();
+
+    context(const context &) = delete;
+    context &operator=(const context &) = delete;
+
+    std::span<const output> outputs();
+    void set_outputs(const digest::map<display::state> &);
+
+    // Describes the requests set_outputs would send, one per line. Nothing
+    // is listed when the running layout already matches.
+    std::string plan_outputs(const digest::map<display::state> &);
+};
+
+// Each of these opens a context of its own.
 std::vector<output> get_outputs();
-void set_outputs(const std::unordered_map<std::string, display::state> &);
+void set_outputs(const digest::map<display::state> &);
+std::string plan_outputs(const digest::map<display::state> &);
+
+// Appends every probe and apply made from now on, with the RandR state it
+// saw and how long it took, to a capture at `path`.
+void record_session(const std::string &path);
+
+// Serves probes and applies from a capture written by record_session
+// instead of the X server, taking as long as the recorded session did.
+// Nothing is sent to the server.
+void replay_session(const std::string &path);
+
+// Makes every probe ask the server to re-poll its connectors, instead of
+// only when what it last saw looks stale. Slow with some drivers, but
+// finds displays the server hasn't noticed yet.
+void probe_hardware(bool probe);
+
+// Picks the layout for a sorted list of connected EDID digests, or nothing
+// to leave the running layout alone.
+using layout_selector =
+    std::function<std::optional<digest::map<state>>(
+        const std::vector<digest::sha256> &)>;
+
+// Keeps one session open and applies the selected layout at startup and
+// whenever the set of connected EDIDs changes. Bursts of RandR events are
+// coalesced until none arrive for `settle_ms`. Never returns.
+[[noreturn]] void watch_outputs(const layout_selector &select,
+                                int settle_ms = 250);
 
 } // namespace display
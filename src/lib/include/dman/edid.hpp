@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <dman/display.hpp>
+#include <optional>
+#include <string_view>
+
+namespace display
+{
+
+// A detailed timing, from the base block or a CTA-861 or DisplayID
+// extension.
+struct detailed_timing
+{
+    // In kHz.
+    uint32_t pixel_clock = 0;
+    uint16_t h_active = 0;
+    uint16_t h_blank = 0;
+    uint16_t h_sync_offset = 0;
+    uint16_t h_sync_width = 0;
+    uint16_t v_active = 0;
+    uint16_t v_blank = 0;
+    uint16_t v_sync_offset = 0;
+    uint16_t v_sync_width = 0;
+    bool interlaced = false;
+    bool h_sync_positive = false;
+    bool v_sync_positive = false;
+    bool preferred = false;
+
+    // As the X server derives a mode from it, so it compares equal to the
+    // timing of the matching RandR mode.
+    struct timing timing() const;
+};
+
+// The monitor range limits descriptor.
+struct range_limits
+{
+    // In Hz.
+    uint16_t min_v_rate = 0;
+    uint16_t max_v_rate = 0;
+    // In kHz.
+    uint16_t min_h_rate = 0;
+    uint16_t max_h_rate = 0;
+    // In kHz, or 0 when not given.
+    uint32_t max_pixel_clock = 0;
+};
+
+// In Hz.
+struct refresh_range
+{
+    unsigned int min = 0;
+    unsigned int max = 0;
+};
+
+// Decodes an EDID in place as its fields are asked for, without copying or
+// allocating. The bytes must outlive the view. Everything reads as absent
+// unless there's a whole base block starting with the EDID header.
+class edid_view
+{
+    const uint8_t *data;
+    size_t size;
+
+    const uint8_t *block(size_t index) const;
+    size_t block_count() const;
+
+  public:
+    edid_view(const void *data, size_t size);
+
+    bool valid() const;
+
+    // Three letters, such as DEL.
+    std::array<char, 3> manufacturer_id() const;
+    uint16_t product_code() const;
+    uint32_t serial_number() const;
+
+    // From the monitor name descriptor, or empty.
+    std::string_view monitor_name() const;
+
+    std::optional<range_limits> limits() const;
+
+    // Where next_timing continues from.
+    struct cursor
+    {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    // The detailed timing after `at`, in the order the blocks list them.
+    std::optional<detailed_timing> next_timing(cursor &at) const;
+
+    template <typename F> void for_each_timing(F &&visit) const
+    {
+        cursor at;
+        while (std::optional<detailed_timing> timing = next_timing(at))
+            visit(*timing);
+    }
+
+    // The first timing marked preferred, which the base block's first
+    // detailed timing always is, else the first one listed.
+    std::optional<detailed_timing> preferred_timing() const;
+
+    // From the HDMI Forum block of a CTA-861 extension, or the range
+    // limits of a panel that declares continuous frequencies.
+    std::optional<refresh_range> vrr_range() const;
+
+    // From DisplayID display parameters, else the preferred timing.
+    std::optional<vec2<unsigned int>> native_resolution() const;
+};
+
+} // namespace display
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <stdexcept>
+#include <string>
 
 namespace common
 {
@@ -16,4 +18,18 @@ class not_found : public exception
     using exception::exception;
 };
 
+class parse_error : public exception
+{
+  public:
+    size_t line;
+    size_t column;
+
+    parse_error(size_t line, size_t column, const std::string &message)
+        : exception("line " + std::to_string(line) + ", column " +
+                    std::to_string(column) + ": " + message),
+          line(line), column(column)
+    {
+    }
+};
+
 } // namespace common
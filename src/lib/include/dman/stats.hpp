@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Where a run of dman spends its time, split into phases. Requests and
+// round trips are counted where they are sent to the X server, bytes are
+// request and reply payloads, and time is wall time spent inside the phase
+// excluding any phase nested in it.
+namespace stats
+{
+
+enum class phase : uint8_t
+{
+    OTHER,
+    CONNECT,
+    PROBE,
+    EDID,
+    PARSE,
+    PLAN,
+    APPLY,
+    COUNT
+};
+
+struct counters
+{
+    uint64_t requests = 0;
+    uint64_t round_trips = 0;
+    uint64_t bytes = 0;
+    std::chrono::nanoseconds time{0};
+};
+
+const counters &get(phase phase);
+
+// Counts against the phase of the innermost live scope.
+void record(uint64_t requests, uint64_t round_trips, uint64_t bytes);
+void record(phase phase,
+            uint64_t requests,
+            uint64_t round_trips,
+            uint64_t bytes);
+
+// Makes `phase` current, and charges it the time, until destroyed.
+class scope
+{
+    phase previous;
+
+  public:
+    explicit scope(phase phase);
+    ~scope();
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+};
+
+// One JSON object with an entry per phase.
+std::string json();
+
+} // namespace stats
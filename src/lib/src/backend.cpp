@@ -0,0 +1,332 @@
+#include "backend.hpp"
+
+#include <dman/exception.hpp>
+#include <charconv>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+// Captures are line based. Each probe is a `probe NS` line followed by the
+// snapshot and an `end` line; each commit is one `commit NS REQUESTS` line.
+
+using clock_type = std::chrono::steady_clock;
+
+static std::string edid_hex(const std::vector<uint8_t> &edid)
+{
+    static const char hex_chars[] = "0123456789abcdef";
+
+    if (edid.empty())
+        return "-";
+
+    std::string result;
+    result.reserve(edid.size() * 2);
+    for (uint8_t byte : edid)
+    {
+        result.push_back(hex_chars[byte >> 4]);
+        result.push_back(hex_chars[byte & 0x0F]);
+    }
+    return result;
+}
+
+// Nothing when `hex` isn't pairs of hex digits.
+static std::optional<std::vector<uint8_t>>
+edid_from_hex(const std::string &hex)
+{
+    std::vector<uint8_t> result;
+
+    if (hex == "-")
+        return result;
+
+    if (hex.size() % 2 != 0)
+        return std::nullopt;
+
+    result.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2)
+    {
+        uint8_t byte = 0;
+        const char *first = hex.data() + i;
+        auto [end, error] = std::from_chars(first, first + 2, byte, 16);
+        if (error != std::errc() || end != first + 2)
+            return std::nullopt;
+        result.push_back(byte);
+    }
+    return result;
+}
+
+template <typename T>
+static void write_list(std::ostream &out, const std::vector<T> &values)
+{
+    out << " " << values.size();
+    for (const T &value : values)
+        out << " " << value;
+}
+
+template <typename T>
+static void read_list(std::istream &in, std::vector<T> &values)
+{
+    size_t size = 0;
+    in >> size;
+    values.resize(size);
+    for (T &value : values)
+        in >> value;
+}
+
+static void write_snapshot(std::ostream &out, const x11::snapshot &snapshot)
+{
+    out << "screen " << snapshot.screen_size.x << " " << snapshot.screen_size.y
+        << " " << snapshot.screen_size_mm.x << " " << snapshot.screen_size_mm.y
+        << " " << snapshot.primary << " " << snapshot.timestamp << " "
+        << snapshot.config_timestamp << "\n";
+
+    out << "atoms " << snapshot.edid_property << " "
+        << snapshot.tearfree_property;
+    for (Atom value : snapshot.tearfree_values)
+        out << " " << value;
+    out << "\n";
+
+    for (const x11::snapshot::mode &mode : snapshot.modes)
+        out << "mode " << mode.id << " " << mode.width << " " << mode.height
+            << " " << mode.dot_clock << " " << mode.h_total << " "
+            << mode.v_total << " " << mode.flags << " " << snapshot.name(mode)
+            << "\n";
+
+    for (const x11::snapshot::crtc &crtc : snapshot.crtcs)
+    {
+        out << "crtc " << crtc.id << " " << crtc.x << " " << crtc.y << " "
+            << crtc.width << " " << crtc.height << " " << crtc.mode << " "
+            << crtc.rotation;
+        write_list(out, crtc.outputs);
+        out << "\n";
+    }
+
+    for (const x11::snapshot::output &output : snapshot.outputs)
+    {
+        out << "output " << output.id << " " << output.crtc << " "
+            << output.connection << " " << (int)output.tearfree;
+        write_list(out, output.crtcs);
+        write_list(out, output.modes);
+        out << " " << edid_hex(output.edid) << " " << output.name << "\n";
+    }
+}
+
+static void check(const std::istream &fields, const std::string &line)
+{
+    if (!fields)
+        throw common::exception("Invalid capture line: " + line);
+}
+
+// Names come last on their line and may be empty.
+static std::string read_name(std::istream &fields)
+{
+    std::string name;
+    std::getline(fields >> std::ws, name);
+    return name;
+}
+
+// Reads snapshot lines up to and including `end`.
+static x11::snapshot read_snapshot(std::istream &in)
+{
+    x11::snapshot snapshot;
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+
+        if (kind == "end")
+        {
+            snapshot.index_modes();
+            return snapshot;
+        }
+
+        if (kind == "screen")
+        {
+            fields >> snapshot.screen_size.x >> snapshot.screen_size.y >>
+                snapshot.screen_size_mm.x >> snapshot.screen_size_mm.y >>
+                snapshot.primary >> snapshot.timestamp >>
+                snapshot.config_timestamp;
+            check(fields, line);
+        }
+        else if (kind == "atoms")
+        {
+            fields >> snapshot.edid_property >> snapshot.tearfree_property;
+            for (Atom &value : snapshot.tearfree_values)
+                fields >> value;
+            check(fields, line);
+        }
+        else if (kind == "mode")
+        {
+            x11::snapshot::mode mode;
+            fields >> mode.id >> mode.width >> mode.height >> mode.dot_clock >>
+                mode.h_total >> mode.v_total >> mode.flags;
+            check(fields, line);
+            snapshot.add_mode(mode, read_name(fields));
+        }
+        else if (kind == "crtc")
+        {
+            x11::snapshot::crtc crtc;
+            fields >> crtc.id >> crtc.x >> crtc.y >> crtc.width >>
+                crtc.height >> crtc.mode >> crtc.rotation;
+            read_list(fields, crtc.outputs);
+            check(fields, line);
+            snapshot.crtcs.push_back(crtc);
+        }
+        else if (kind == "output")
+        {
+            x11::snapshot::output output;
+            int tearfree = 0;
+            std::string edid;
+            fields >> output.id >> output.crtc >> output.connection >> tearfree;
+            read_list(fields, output.crtcs);
+            read_list(fields, output.modes);
+            fields >> edid;
+            check(fields, line);
+            output.name = read_name(fields);
+            output.tearfree = (display::tearfree)tearfree;
+            std::optional<std::vector<uint8_t>> bytes = edid_from_hex(edid);
+            if (!bytes)
+                throw common::exception("Invalid capture line: " + line);
+            output.edid = std::move(*bytes);
+            snapshot.outputs.push_back(output);
+        }
+        else
+        {
+            throw common::exception("Invalid capture line: " + line);
+        }
+    }
+
+    throw common::exception("Capture ends inside a snapshot.");
+}
+
+namespace backend
+{
+
+live::live(bool _probe_hardware) : probe_hardware(_probe_hardware)
+{
+}
+
+x11::snapshot live::probe()
+{
+    return x11::snapshot(sess, probe_hardware);
+}
+
+size_t live::commit(const x11::snapshot &before, const x11::layout &target)
+{
+    x11::transaction transaction(sess, before);
+    return transaction.commit(target);
+}
+
+recorder::recorder(std::unique_ptr<randr> _inner, const std::string &path)
+    : inner(std::move(_inner)), out(path, std::ios::out | std::ios::app)
+{
+    if (!out)
+        throw common::exception("Failed to open file: " + path);
+}
+
+x11::snapshot recorder::probe()
+{
+    clock_type::time_point start = clock_type::now();
+    x11::snapshot snapshot = inner->probe();
+    std::chrono::nanoseconds elapsed = clock_type::now() - start;
+
+    out << "probe " << elapsed.count() << "\n";
+    write_snapshot(out, snapshot);
+    out << "end" << std::endl;
+
+    return snapshot;
+}
+
+size_t recorder::commit(const x11::snapshot &before, const x11::layout &target)
+{
+    clock_type::time_point start = clock_type::now();
+    size_t requests = inner->commit(before, target);
+    std::chrono::nanoseconds elapsed = clock_type::now() - start;
+
+    out << "commit " << elapsed.count() << " " << requests << std::endl;
+
+    return requests;
+}
+
+replay::replay(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in)
+        throw common::not_found(path);
+
+    std::chrono::nanoseconds commit_time{0};
+    size_t commit_requests = 0;
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        int64_t elapsed = 0;
+        fields >> kind >> elapsed;
+
+        if (kind == "probe")
+        {
+            probes.emplace_back(std::chrono::nanoseconds(elapsed),
+                                read_snapshot(in));
+        }
+        else if (kind == "commit")
+        {
+            size_t requests = 0;
+            fields >> requests;
+            commit_time += std::chrono::nanoseconds(elapsed);
+            commit_requests += requests;
+        }
+        else if (!kind.empty())
+        {
+            throw common::exception("Invalid capture line: " + line);
+        }
+    }
+
+    if (probes.empty())
+        throw common::exception("Capture has no probes: " + path);
+
+    if (commit_requests > 0)
+        request_latency = commit_time / commit_requests;
+}
+
+x11::snapshot replay::probe()
+{
+    stats::scope scope(stats::phase::PROBE);
+
+    const auto &[latency, snapshot] = probes[next_probe];
+    if (next_probe + 1 < probes.size())
+        ++next_probe;
+
+    std::this_thread::sleep_for(latency);
+    return snapshot;
+}
+
+size_t replay::commit(const x11::snapshot &before, const x11::layout &target)
+{
+    stats::scope scope(stats::phase::APPLY);
+
+    size_t requests = x11::count_requests(before, target);
+    stats::record(requests, requests > 0, 0);
+    std::this_thread::sleep_for(request_latency * requests);
+    return requests;
+}
+
+std::unique_ptr<randr> open(const module::options &options)
+{
+    std::unique_ptr<randr> result;
+
+    if (!options.replay_path.empty())
+        result = std::make_unique<replay>(options.replay_path);
+    else
+        result = std::make_unique<live>(options.probe_hardware);
+
+    if (!options.record_path.empty())
+        result =
+            std::make_unique<recorder>(std::move(result), options.record_path);
+
+    return result;
+}
+
+} // namespace backend
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "module.hpp"
+#include "x11.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Where display.cpp reads RandR state from and sends layouts to: a live X
+// server, or a capture of one served back with its recorded latencies.
+namespace backend
+{
+
+class randr
+{
+  public:
+    virtual ~randr() {};
+
+    virtual x11::snapshot probe() = 0;
+    // Returns the number of requests the layout took.
+    virtual size_t commit(const x11::snapshot &before,
+                          const x11::layout &target) = 0;
+};
+
+class live : public randr
+{
+    x11::session sess;
+    bool probe_hardware;
+
+  public:
+    explicit live(bool probe_hardware);
+
+    x11::snapshot probe() override;
+    size_t commit(const x11::snapshot &before,
+                  const x11::layout &target) override;
+};
+
+// Forwards to another backend and appends every probe, with the snapshot it
+// returned, and every commit, with its request count, to a capture file.
+// Each entry records how long it took.
+class recorder : public randr
+{
+    std::unique_ptr<randr> inner;
+    std::ofstream out;
+
+  public:
+    recorder(std::unique_ptr<randr> inner, const std::string &path);
+
+    x11::snapshot probe() override;
+    size_t commit(const x11::snapshot &before,
+                  const x11::layout &target) override;
+};
+
+// Serves the probes of a capture in order, repeating the last one once they
+// run out, each after its recorded latency. A commit sends nothing and
+// takes the capture's average time per request for every request the
+// layout would need.
+class replay : public randr
+{
+    std::vector<std::pair<std::chrono::nanoseconds, x11::snapshot>> probes;
+    size_t next_probe = 0;
+    std::chrono::nanoseconds request_latency{0};
+
+  public:
+    explicit replay(const std::string &path);
+
+    x11::snapshot probe() override;
+    size_t commit(const x11::snapshot &before,
+                  const x11::layout &target) override;
+};
+
+// A replay when the options name one, otherwise a live session, recorded
+// when they name a capture to write.
+std::unique_ptr<randr> open(const module::options &options);
+
+} // namespace backend
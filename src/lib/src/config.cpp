@@ -1,244 +1,432 @@
 #include <dman/config.hpp>
 #include <dman/display.hpp>
-#include <sstream>
+#include <dman/exception.hpp>
+#include <dman/stats.hpp>
+#include <algorithm>
+#include <charconv>
+#include <string_view>
 
-std::string strip_whitespace(const std::string &str)
+namespace
 {
-    size_t start = str.find_first_not_of(" \t\r\n");
-    size_t end = str.find_last_not_of(" \t\r\n");
-    if (start == std::string::npos || end == std::string::npos)
-        return "";
-    return str.substr(start, end - start + 1);
+
+enum class config_key
+{
+    unknown,
+    x,
+    y,
+    width,
+    height,
+    rate,
+    timing,
+    name,
+    rotation,
+    tearfree,
+};
+
+constexpr uint32_t key_hash(std::string_view key)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : key)
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+    return hash;
 }
 
-std::string get_next_nonempty_line(std::stringstream &ss)
+// Tokens are views into the config text; `column` is 1-based.
+struct token
 {
-    std::string line;
-    while (std::getline(ss, line))
+    std::string_view text;
+    size_t column;
+};
+
+} // namespace
+
+static config_key find_key(std::string_view key)
+{
+    auto expect = [&](std::string_view name, config_key result)
+    { return key == name ? result : config_key::unknown; };
+
+    switch (key_hash(key))
     {
-        line = strip_whitespace(line);
-        if (!line.empty())
-        {
-            return line;
-        }
+    case key_hash("x"):
+        return expect("x", config_key::x);
+    case key_hash("y"):
+        return expect("y", config_key::y);
+    case key_hash("width"):
+        return expect("width", config_key::width);
+    case key_hash("height"):
+        return expect("height", config_key::height);
+    case key_hash("rate"):
+        return expect("rate", config_key::rate);
+    case key_hash("timing"):
+        return expect("timing", config_key::timing);
+    case key_hash("name"):
+        return expect("name", config_key::name);
+    case key_hash("rotation"):
+        return expect("rotation", config_key::rotation);
+    case key_hash("tearfree"):
+        return expect("tearfree", config_key::tearfree);
+    default:
+        return config_key::unknown;
     }
-    return "";
 }
 
-std::vector<std::string> split_words(const std::string &line)
+static bool is_blank(char c)
 {
-    std::vector<std::string> words;
-    std::istringstream iss(line);
-    std::string word;
-    while (iss >> word)
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Returns the next whitespace separated word of `line` at or after `pos`,
+// or an empty token at the end of the line.
+static token next_token(std::string_view line, size_t &pos)
+{
+    while (pos < line.size() && is_blank(line[pos]))
+        ++pos;
+
+    size_t start = pos;
+    while (pos < line.size() && !is_blank(line[pos]))
+        ++pos;
+
+    return token{line.substr(start, pos - start), start + 1};
+}
+
+template <typename T>
+static T parse_number(std::string_view value, size_t line, size_t column)
+{
+    T result{};
+    const char *end = value.data() + value.size();
+    auto [ptr, error] = std::from_chars(value.data(), end, result);
+
+    if (error != std::errc() || ptr != end)
+        throw common::parse_error(
+            line, column, "invalid number '" + std::string(value) + "'");
+
+    return result;
+}
+
+// Parses `timing=DOTCLOCK,HTOTAL,VTOTAL,FLAGS`.
+static ::display::timing
+parse_timing(std::string_view value, size_t line, size_t column)
+{
+    uint64_t fields[4];
+
+    for (size_t i = 0, pos = 0; i < 4; ++i)
     {
-        words.push_back(word);
+        size_t end = i < 3 ? value.find(',', pos) : value.size();
+        if (end == std::string_view::npos)
+            throw common::parse_error(
+                line, column + value.size(), "expected four timing fields");
+
+        fields[i] = parse_number<uint64_t>(
+            value.substr(pos, end - pos), line, column + pos);
+        pos = end + 1;
     }
-    return words;
+
+    return ::display::timing{fields[0],
+                             (uint32_t)fields[1],
+                             (uint32_t)fields[2],
+                             (uint32_t)fields[3]};
 }
 
-util::display::config::config(const std::string &config_text)
+static void parse_line(util::display::config &config,
+                       std::string_view line,
+                       size_t line_number,
+                       const digest::set *wanted)
 {
-    std::stringstream ss(config_text);
-    while (ss)
-    {
-        std::vector<std::string> args = split_words(get_next_nonempty_line(ss));
+    size_t pos = 0;
+    token first = next_token(line, pos);
 
-        if (args.empty())
-            continue;
+    if (first.text.empty())
+        return;
 
-        const std::string &edid = args[0];
+    std::optional<digest::sha256> edid = digest::sha256::parse_hex(first.text);
+    if (!edid)
+        throw common::parse_error(line_number,
+                                  first.column,
+                                  "invalid EDID hash '" +
+                                      std::string(first.text) + "'");
 
-        ::display::state &state = outputs[edid];
+    if (wanted && !wanted->contains(*edid))
+        return;
 
-        state.is_active = true;
+    ::display::state &state = config.outputs[*edid];
 
-        for (int i = 1; i < args.size(); ++i)
+    state.is_active = true;
+
+    for (token arg = next_token(line, pos); !arg.text.empty();
+         arg = next_token(line, pos))
+    {
+        size_t equal_pos = arg.text.find('=');
+
+        if (equal_pos == std::string_view::npos)
         {
-            const std::string &arg = args[i];
-            size_t equal_pos = arg.find('=');
-
-            if (equal_pos == std::string::npos)
-            {
-                if (arg == "primary")
-                    state.is_primary = true;
-                continue;
-            }
-            std::string key = arg.substr(0, equal_pos);
-            std::string value = arg.substr(equal_pos + 1);
-            if (key == "x")
-            {
-                state.position.x = std::stoi(value);
-            }
-            else if (key == "y")
-            {
-                state.position.y = std::stoi(value);
-            }
-            else if (key == "width")
-            {
-                state.mode.width = std::stoi(value);
-            }
-            else if (key == "height")
-            {
-                state.mode.height = std::stoi(value);
-            }
-            else if (key == "rate")
-            {
-                state.mode.rate = std::stod(value);
-            }
-            else if (key == "name")
-            {
-                associate_name_edid(value, edid);
-            }
-            else if (key == "rotation")
-            {
-                if (value == "normal")
-                    state.rotation = ::display::rotation::NORMAL;
-                else if (value == "left")
-                    state.rotation = ::display::rotation::LEFT;
-                else if (value == "right")
-                    state.rotation = ::display::rotation::RIGHT;
-                else if (value == "inverted")
-                    state.rotation = ::display::rotation::INVERTED;
-            }
-            else if (key == "tearfree")
-            {
-                if (value == "on")
-                    state.is_tearfree = ::display::tearfree::ON;
-                else if (value == "auto")
-                    state.is_tearfree = ::display::tearfree::AUTO;
-                else if (value == "off")
-                    state.is_tearfree = ::display::tearfree::OFF;
-            }
+            if (arg.text == "primary")
+                state.is_primary = true;
+            continue;
+        }
+
+        std::string_view key = arg.text.substr(0, equal_pos);
+        std::string_view value = arg.text.substr(equal_pos + 1);
+        size_t column = arg.column + equal_pos + 1;
+
+        switch (find_key(key))
+        {
+        case config_key::x:
+            state.position.x =
+                parse_number<unsigned int>(value, line_number, column);
+            break;
+        case config_key::y:
+            state.position.y =
+                parse_number<unsigned int>(value, line_number, column);
+            break;
+        case config_key::width:
+            state.mode.width =
+                parse_number<unsigned int>(value, line_number, column);
+            break;
+        case config_key::height:
+            state.mode.height =
+                parse_number<unsigned int>(value, line_number, column);
+            break;
+        case config_key::rate:
+            state.mode.rate = parse_number<double>(value, line_number, column);
+            break;
+        case config_key::timing:
+            state.mode.timing = parse_timing(value, line_number, column);
+            break;
+        case config_key::name:
+            config.associate_name_edid(std::string(value), *edid);
+            break;
+        case config_key::rotation:
+            if (value == "normal")
+                state.rotation = ::display::rotation::NORMAL;
+            else if (value == "left")
+                state.rotation = ::display::rotation::LEFT;
+            else if (value == "right")
+                state.rotation = ::display::rotation::RIGHT;
+            else if (value == "inverted")
+                state.rotation = ::display::rotation::INVERTED;
+            break;
+        case config_key::tearfree:
+            if (value == "on")
+                state.is_tearfree = ::display::tearfree::ON;
+            else if (value == "auto")
+                state.is_tearfree = ::display::tearfree::AUTO;
+            else if (value == "off")
+                state.is_tearfree = ::display::tearfree::OFF;
+            break;
+        case config_key::unknown:
+            break;
         }
     }
 }
 
+static void parse(util::display::config &config,
+                  std::string_view config_text,
+                  const digest::set *wanted)
+{
+    size_t line_number = 0;
+
+    for (size_t pos = 0; pos < config_text.size();)
+    {
+        size_t end = config_text.find('\n', pos);
+        if (end == std::string_view::npos)
+            end = config_text.size();
+
+        parse_line(config,
+                   config_text.substr(pos, end - pos),
+                   ++line_number,
+                   wanted);
+        pos = end + 1;
+    }
+}
+
+util::display::config::config(std::string_view config_text)
+{
+    stats::scope scope(stats::phase::PARSE);
+    parse(*this, config_text, nullptr);
+}
+
+util::display::config::config(std::string_view config_text,
+                              const digest::set &wanted)
+{
+    stats::scope scope(stats::phase::PARSE);
+    parse(*this, config_text, &wanted);
+}
+
 void util::display::config::associate_name_edid(const std::string &name,
-                                                const std::string &edid)
+                                                const digest::sha256 &edid)
 {
     name_to_edid[name] = edid;
     edid_to_name[edid] = name;
 }
 
-util::display::config::config(const std::vector<::display::output> &outputs)
+util::display::config::config(std::span<const ::display::output> outputs)
 {
     for (const ::display::output &output : outputs)
     {
-        std::string hex = output.edid.digest.hex();
         if (output.is_active)
         {
-            associate_name_edid(output.edid.name, hex);
-            this->outputs[hex] = output;
+            associate_name_edid(std::string(output.edid.name),
+                                output.edid.digest);
+            this->outputs[output.edid.digest] = output;
         }
     }
 }
 
-std::string util::display::config::get_edid(const std::string &id) const
+std::optional<digest::sha256>
+util::display::config::get_edid(const std::string &id) const
 {
     auto it = name_to_edid.find(id);
     if (it != name_to_edid.end())
     {
         return it->second;
     }
-    return id;
+    return digest::sha256::parse_hex(id);
 }
 
-std::string util::display::config::get_name(const std::string &id) const
+std::string util::display::config::get_name(const digest::sha256 &edid) const
 {
-    auto it = edid_to_name.find(id);
+    auto it = edid_to_name.find(edid);
     if (it != edid_to_name.end())
     {
         return it->second;
     }
-    return id;
+    return edid.hex();
 }
 
 const ::display::state &
 util::display::config::operator[](const std::string &name) const
 {
-    std::string edid = get_edid(name);
-    auto it = outputs.find(edid);
+    std::optional<digest::sha256> edid = get_edid(name);
+    auto it = edid ? outputs.find(*edid) : outputs.end();
     if (it != outputs.end())
         return it->second;
 
     static ::display::state empty_state;
     return empty_state;
 }
-util::display::config::operator std::string() const
+template <typename T> static void append_number(std::string &out, T value)
+{
+    char buffer[32];
+    std::to_chars_result result =
+        std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+static std::string_view rotation_name(::display::rotation rotation)
 {
-    std::ostringstream oss;
-    for (const auto &[edid, state] : outputs)
+    switch (rotation)
     {
-        if (!state.is_active)
-            continue;
+    case ::display::rotation::LEFT:
+        return "left";
+    case ::display::rotation::RIGHT:
+        return "right";
+    case ::display::rotation::INVERTED:
+        return "inverted";
+    default:
+        return "normal";
+    }
+}
 
-        oss << edid;
-        oss << " x=" << state.position.x;
-        oss << " y=" << state.position.y;
+static std::string_view tearfree_name(::display::tearfree tearfree)
+{
+    switch (tearfree)
+    {
+    case ::display::tearfree::ON:
+        return "on";
+    case ::display::tearfree::AUTO:
+        return "auto";
+    case ::display::tearfree::OFF:
+        return "off";
+    default:
+        return "";
+    }
+}
 
-        oss << " width=" << state.mode.width;
-        oss << " height=" << state.mode.height;
-        oss << " rate=" << state.mode.rate;
+void util::display::config::serialize(std::string &out) const
+{
+    using entry = std::pair<const digest::sha256, ::display::state>;
 
-        const auto it = edid_to_name.find(edid);
+    std::vector<const entry *> active;
+    active.reserve(outputs.size());
+    for (const entry &output : outputs)
+    {
+        if (output.second.is_active)
+            active.push_back(&output);
+    }
 
-        if (it != edid_to_name.end())
+    std::sort(active.begin(),
+              active.end(),
+              [](const entry *a, const entry *b) { return a->first < b->first; });
+
+    for (const entry *output : active)
+    {
+        const auto &[edid, state] = *output;
+
+        char hex[64];
+        out.append(hex, edid.hex(hex));
+
+        out += " x=";
+        append_number(out, state.position.x);
+        out += " y=";
+        append_number(out, state.position.y);
+        out += " width=";
+        append_number(out, state.mode.width);
+        out += " height=";
+        append_number(out, state.mode.height);
+        out += " rate=";
+        append_number(out, state.mode.rate);
+
+        if (!state.mode.timing.empty())
         {
-            const std::string &name = it->second;
-            oss << " name=" << name;
+            const ::display::timing &timing = state.mode.timing;
+            out += " timing=";
+            append_number(out, timing.dot_clock);
+            out += ',';
+            append_number(out, timing.h_total);
+            out += ',';
+            append_number(out, timing.v_total);
+            out += ',';
+            append_number(out, timing.flags);
         }
 
-        oss << " rotation=";
-        switch (state.rotation)
+        const auto it = edid_to_name.find(edid);
+        if (it != edid_to_name.end())
         {
-        case ::display::rotation::NORMAL:
-            oss << "normal";
-            break;
-        case ::display::rotation::LEFT:
-            oss << "left";
-            break;
-        case ::display::rotation::RIGHT:
-            oss << "right";
-            break;
-        case ::display::rotation::INVERTED:
-            oss << "inverted";
-            break;
+            out += " name=";
+            out += it->second;
         }
 
+        out += " rotation=";
+        out += rotation_name(state.rotation);
+
         if (state.is_primary)
-            oss << " primary";
+            out += " primary";
 
         if (state.is_tearfree != ::display::tearfree::UNSET)
         {
-            oss << " tearfree=";
-            switch (state.is_tearfree)
-            {
-            case ::display::tearfree::ON:
-                oss << "on";
-                break;
-            case ::display::tearfree::AUTO:
-                oss << "auto";
-                break;
-            case ::display::tearfree::OFF:
-                oss << "off";
-                break;
-            default:
-                break;
-            }
+            out += " tearfree=";
+            out += tearfree_name(state.is_tearfree);
         }
 
-        oss << "\n";
+        out += '\n';
     }
-    return oss.str();
+}
+
+util::display::config::operator std::string() const
+{
+    std::string result;
+    serialize(result);
+    return result;
 }
 
 void util::display::config::toggle_output(const std::string &name)
 {
     if (name.empty())
         return;
-    std::string edid = get_edid(name);
-    auto it = outputs.find(edid);
+    std::optional<digest::sha256> edid = get_edid(name);
+    if (!edid)
+        return;
+    auto it = outputs.find(*edid);
     if (it == outputs.end())
         return;
     ::display::state &state = it->second;
@@ -249,8 +437,10 @@ void util::display::config::enable_output(const std::string &name)
 {
     if (name.empty())
         return;
-    std::string edid = get_edid(name);
-    auto it = outputs.find(edid);
+    std::optional<digest::sha256> edid = get_edid(name);
+    if (!edid)
+        return;
+    auto it = outputs.find(*edid);
     if (it == outputs.end())
         return;
     ::display::state &state = it->second;
@@ -261,8 +451,10 @@ void util::display::config::disable_output(const std::string &name)
 {
     if (name.empty())
         return;
-    std::string edid = get_edid(name);
-    auto it = outputs.find(edid);
+    std::optional<digest::sha256> edid = get_edid(name);
+    if (!edid)
+        return;
+    auto it = outputs.find(*edid);
     if (it == outputs.end())
         return;
     ::display::state &state = it->second;
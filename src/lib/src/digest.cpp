@@ -1,56 +1,98 @@
 #include <dman/digest.hpp>
 
-#include <gcrypt.h>
+#include "sha256.hpp"
+
 #include <stdexcept>
 
 digest::sha256::sha256(const void *begin, size_t size)
 {
-    gcry_md_hash_buffer(GCRY_MD_SHA256, content, begin, size);
+    sha2::hash256(begin, size, content);
 }
 
 std::string digest::sha256::hex() const
 {
-    static const char hex_chars[] = "0123456789abcdef";
-    std::string result;
-    result.reserve(64);
-    for (size_t i = 0; i < 32; ++i)
-    {
-        result.push_back(hex_chars[(content[i] >> 4) & 0x0F]);
-        result.push_back(hex_chars[content[i] & 0x0F]);
-    }
+    std::string result(2 * sizeof(content), '\0');
+    hex(result.data());
     return result;
 }
 
-bool digest::sha256::operator==(const digest::sha256 &other) const
+char *digest::sha256::hex(char *out) const
 {
-    for (size_t i = 0; i < 32; ++i)
+    static const char hex_chars[] = "0123456789abcdef";
+    for (size_t i = 0; i < sizeof(content); ++i)
     {
-        if (content[i] != other.content[i])
-        {
-            return false;
-        }
+        *out++ = hex_chars[(content[i] >> 4) & 0x0F];
+        *out++ = hex_chars[content[i] & 0x0F];
     }
-    return true;
+    return out;
 }
 
-bool digest::sha256::operator==(const std::string &hex_str) const
+bool digest::sha256::operator==(const digest::sha256 &other) const
 {
-    return hex() == hex_str;
+    return std::memcmp(content, other.content, sizeof(content)) == 0;
 }
 
-uint8_t hex_char_to_value(char c)
+bool digest::sha256::operator<(const digest::sha256 &other) const
 {
-    c = tolower(c);
+    return std::memcmp(content, other.content, sizeof(content)) < 0;
+}
 
+static int hex_char_to_value(char c)
+{
     if (c >= '0' && c <= '9')
         return c - '0';
     if (c >= 'a' && c <= 'f')
         return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+bool digest::sha256::operator==(std::string_view hex_str) const
+{
+    if (hex_str.size() != 2 * sizeof(content))
+        return false;
+
+    for (size_t i = 0; i < sizeof(content); ++i)
+    {
+        int high = hex_char_to_value(hex_str[2 * i]);
+        int low = hex_char_to_value(hex_str[2 * i + 1]);
+        if (high < 0 || low < 0 || content[i] != ((high << 4) | low))
+            return false;
+    }
+    return true;
+}
+
+std::optional<digest::sha256> digest::sha256::parse_hex(std::string_view hex)
+{
+    sha256 result;
+
+    if (hex.size() != 2 * sizeof(result.content))
+        return std::nullopt;
 
-    throw std::invalid_argument("Invalid hex character");
+    for (size_t i = 0; i < sizeof(result.content); ++i)
+    {
+        int high = hex_char_to_value(hex[2 * i]);
+        int low = hex_char_to_value(hex[2 * i + 1]);
+        if (high < 0 || low < 0)
+            return std::nullopt;
+        result.content[i] = (high << 4) | low;
+    }
+
+    return result;
+}
+
+digest::sha256 digest::sha256::from_hex(std::string_view hex)
+{
+    std::optional<sha256> result = parse_hex(hex);
+    if (!result)
+        throw std::invalid_argument("Invalid SHA-256 hex string: " +
+                                    std::string(hex));
+    return *result;
 }
 
 digest::sha256::sha256(const std::string &input)
     : sha256(input.data(), input.size())
 {
-}
\ No newline at end of file
+}
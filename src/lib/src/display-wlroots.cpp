@@ -1,81 +1,792 @@
-#include <dman/display.hpp>
-#include <cmath>
+#include "wlroots.hpp"
+#include "edid.hpp"
+
 #include <dman/exception.hpp>
-#include <filesystem>
-#include <fstream>
+#include <dman/stats.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+// Version 2 adds make, model and serial number; version 3 adds release
+// requests. Nothing newer is needed.
+static constexpr uint32_t max_version = 3;
+
+// Heads without an EDID, such as virtual and headless outputs, are told
+// apart by what the compositor says about them instead.
+static void s_head_edid(
+    const wlroots::head &head,
+    const std::unordered_map<std::string, std::vector<uint8_t>> &sysfs,
+    display::edid &result)
+{
+    auto it = sysfs.find(head.name);
+    if (it != sysfs.end())
+    {
+        result = edids::decode(it->second);
+        return;
+    }
 
-#define WLR_USE_UNSTABLE
+    result.digest = digest::sha256(head.make + '\n' + head.model + '\n' +
+                                   head.serial_number + '\n' + head.name);
+    result.manufacturer_id = head.make;
+    result.serial_number = head.serial_number;
+    result.name = head.name;
+}
+
+static display::rotation s_transform_to_rotation(int32_t transform,
+                                                 const std::string &name)
+{
+    switch (transform)
+    {
+    case WL_OUTPUT_TRANSFORM_NORMAL:
+        return display::rotation::NORMAL;
+    case WL_OUTPUT_TRANSFORM_90:
+        return display::rotation::RIGHT;
+    case WL_OUTPUT_TRANSFORM_180:
+        return display::rotation::INVERTED;
+    case WL_OUTPUT_TRANSFORM_270:
+        return display::rotation::LEFT;
+    default:
+        std::cerr << "Warning: Unknown transform value " << transform
+                  << " for output " << name << std::endl;
+        return display::rotation::NORMAL;
+    }
+}
 
-extern "C"
+static int32_t s_rotation_to_transform(display::rotation rotation)
 {
-#include <wayland-server-core.h>
-#include <wlr/backend.h>
-#include <wlr/types/wlr_output.h>
+    switch (rotation)
+    {
+    case display::rotation::RIGHT:
+        return WL_OUTPUT_TRANSFORM_90;
+    case display::rotation::INVERTED:
+        return WL_OUTPUT_TRANSFORM_180;
+    case display::rotation::LEFT:
+        return WL_OUTPUT_TRANSFORM_270;
+    default:
+        return WL_OUTPUT_TRANSFORM_NORMAL;
+    }
+}
+
+static const char *s_transform_name(int32_t transform)
+{
+    switch (transform)
+    {
+    case WL_OUTPUT_TRANSFORM_NORMAL:
+        return "normal";
+    case WL_OUTPUT_TRANSFORM_90:
+        return "right";
+    case WL_OUTPUT_TRANSFORM_180:
+        return "inverted";
+    case WL_OUTPUT_TRANSFORM_270:
+        return "left";
+    default:
+        return "unknown";
+    }
+}
+
+static void s_to_mode(const wlroots::mode &mode, display::mode &result)
+{
+    result.name =
+        std::to_string(mode.width) + "x" + std::to_string(mode.height);
+    result.width = mode.width;
+    result.height = mode.height;
+    result.rate = mode.refresh / 1000.0;
+}
+
+// The head's mode of the wanted size with the nearest refresh rate, the
+// earliest listed winning ties.
+static const wlroots::mode *s_find_mode(const wlroots::head &head,
+                                        const display::mode &want)
+{
+    const wlroots::mode *best = nullptr;
+    double best_distance = 0;
+
+    for (const std::unique_ptr<wlroots::mode> &mode : head.modes)
+    {
+        if (mode->width != (int32_t)want.width ||
+            mode->height != (int32_t)want.height)
+            continue;
+
+        double distance = std::abs(mode->refresh / 1000.0 - want.rate);
+        if (!best || distance < best_distance)
+        {
+            best = mode.get();
+            best_distance = distance;
+        }
+    }
+
+    return best;
+}
+
+// What a head should become: nothing to disable it.
+struct head_config
+{
+    const display::state *want = nullptr;
+    const wlroots::mode *mode = nullptr;
 };
 
-namespace display
+static head_config s_head_config(
+    const wlroots::head &head,
+    const digest::map<display::state> &outputs,
+    const std::unordered_map<std::string, std::vector<uint8_t>> &sysfs)
 {
+    display::edid edid;
+    s_head_edid(head, sysfs, edid);
+
+    auto it = outputs.find(edid.digest);
+    if (it == outputs.end() || !it->second.is_active)
+        return {};
+
+    return head_config{&it->second, s_find_mode(head, it->second.mode)};
+}
 
-bool display::mode::operator==(const display::mode &other) const
+// The mode the compositor prefers for the head, else its first.
+static const wlroots::mode *s_preferred_mode(const wlroots::head &head)
 {
-    return (width == other.width) && (height == other.height) &&
-           std::fabs(rate - other.rate) < 1.5;
+    for (const std::unique_ptr<wlroots::mode> &mode : head.modes)
+    {
+        if (mode->preferred)
+            return mode.get();
+    }
+    return head.modes.empty() ? nullptr : head.modes.front().get();
+}
+
+// What every head should become, in the order of `heads`. A layout that
+// would leave no head enabled gets the first one enabled at its preferred
+// mode instead, kept in `fallback`, so applying it can't blank every
+// screen.
+static std::vector<head_config> s_head_configs(
+    const std::vector<std::unique_ptr<wlroots::head>> &heads,
+    const digest::map<display::state> &outputs,
+    const std::unordered_map<std::string, std::vector<uint8_t>> &sysfs,
+    display::state &fallback)
+{
+    std::vector<head_config> result;
+    result.reserve(heads.size());
+
+    bool any_enabled = false;
+    for (const std::unique_ptr<wlroots::head> &head : heads)
+    {
+        head_config &config =
+            result.emplace_back(s_head_config(*head, outputs, sysfs));
+        any_enabled = any_enabled || config.want;
+    }
+
+    if (any_enabled || heads.empty())
+        return result;
+
+    std::cerr << "Warning: No active display found. Activating the first "
+                 "connected display."
+              << std::endl;
+
+    const wlroots::head &head = *heads.front();
+    const wlroots::mode *mode = s_preferred_mode(head);
+
+    fallback = display::state{};
+    if (mode)
+        s_to_mode(*mode, fallback.mode);
+    fallback.is_active = true;
+
+    result.front() = head_config{&fallback, mode};
+    return result;
 }
 
-static std::vector<uint8_t> s_read_binary(const std::string &path)
+static bool s_is_unchanged(const wlroots::head &head, const head_config &config)
 {
-    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!config.want)
+        return !head.enabled;
 
-    if (!stream)
-        throw common::not_found(path);
+    const display::state &want = *config.want;
 
-    std::streamsize size = stream.tellg();
+    // Modeless heads, such as headless ones, keep whatever size they have.
+    bool same_mode = want.mode.width == 0 ||
+                     (config.mode && config.mode == head.current_mode);
 
-    if (size == -1)
-        throw common::not_found(path);
+    return head.enabled && same_mode && head.x == (int32_t)want.position.x &&
+           head.y == (int32_t)want.position.y &&
+           head.transform == s_rotation_to_transform(want.rotation);
+}
 
-    stream.seekg(0, std::ios::beg);
+// Protocol events.
 
-    std::vector<uint8_t> result;
+static void s_on_mode_size(void *data,
+                           zwlr_output_mode_v1 *,
+                           int32_t width,
+                           int32_t height)
+{
+    auto *mode = (wlroots::mode *)data;
+    mode->width = width;
+    mode->height = height;
+}
 
-    result.resize(size);
+static void
+s_on_mode_refresh(void *data, zwlr_output_mode_v1 *, int32_t refresh)
+{
+    ((wlroots::mode *)data)->refresh = refresh;
+}
 
-    stream.read((char *)result.data(), size);
+static void s_on_mode_preferred(void *data, zwlr_output_mode_v1 *)
+{
+    ((wlroots::mode *)data)->preferred = true;
+}
 
-    if (!stream.good())
-        throw common::not_found(path);
+static void s_on_mode_finished(void *data, zwlr_output_mode_v1 *handle)
+{
+    auto *mode = (wlroots::mode *)data;
+    wlroots::head *head = mode->head;
+
+    if (head->sess->version >= 3)
+        zwlr_output_mode_v1_release(handle);
+    else
+        zwlr_output_mode_v1_destroy(handle);
+
+    if (head->current_mode == mode)
+        head->current_mode = nullptr;
+
+    std::erase_if(head->modes, [&](const std::unique_ptr<wlroots::mode> &m) {
+        return m.get() == mode;
+    });
+}
+
+static const zwlr_output_mode_v1_listener s_mode_listener = {
+    .size = s_on_mode_size,
+    .refresh = s_on_mode_refresh,
+    .preferred = s_on_mode_preferred,
+    .finished = s_on_mode_finished,
+};
+
+static void s_on_head_name(void *data, zwlr_output_head_v1 *, const char *name)
+{
+    ((wlroots::head *)data)->name = name;
+}
+
+static void s_on_head_description(void *, zwlr_output_head_v1 *, const char *)
+{
+}
+
+static void
+s_on_head_physical_size(void *, zwlr_output_head_v1 *, int32_t, int32_t)
+{
+}
+
+static void
+s_on_head_mode(void *data, zwlr_output_head_v1 *, zwlr_output_mode_v1 *handle)
+{
+    auto *head = (wlroots::head *)data;
+
+    auto mode = std::make_unique<wlroots::mode>();
+    mode->handle = handle;
+    mode->head = head;
+    zwlr_output_mode_v1_add_listener(handle, &s_mode_listener, mode.get());
+
+    head->modes.push_back(std::move(mode));
+}
+
+static void
+s_on_head_enabled(void *data, zwlr_output_head_v1 *, int32_t enabled)
+{
+    auto *head = (wlroots::head *)data;
+    head->enabled = enabled;
+    if (!enabled)
+        head->current_mode = nullptr;
+}
+
+static void s_on_head_current_mode(void *,
+                                   zwlr_output_head_v1 *,
+                                   zwlr_output_mode_v1 *handle)
+{
+    auto *mode = (wlroots::mode *)zwlr_output_mode_v1_get_user_data(handle);
+    mode->head->current_mode = mode;
+}
+
+static void
+s_on_head_position(void *data, zwlr_output_head_v1 *, int32_t x, int32_t y)
+{
+    auto *head = (wlroots::head *)data;
+    head->x = x;
+    head->y = y;
+}
+
+static void
+s_on_head_transform(void *data, zwlr_output_head_v1 *, int32_t transform)
+{
+    ((wlroots::head *)data)->transform = transform;
+}
+
+static void s_on_head_scale(void *, zwlr_output_head_v1 *, wl_fixed_t)
+{
+}
+
+static void s_on_head_finished(void *data, zwlr_output_head_v1 *handle)
+{
+    auto *head = (wlroots::head *)data;
+    wlroots::session *sess = head->sess;
+
+    // Normally each mode has finished first.
+    for (std::unique_ptr<wlroots::mode> &mode : head->modes)
+        zwlr_output_mode_v1_destroy(mode->handle);
+
+    if (sess->version >= 3)
+        zwlr_output_head_v1_release(handle);
+    else
+        zwlr_output_head_v1_destroy(handle);
+
+    std::erase_if(sess->heads, [&](const std::unique_ptr<wlroots::head> &h) {
+        return h.get() == head;
+    });
+}
+
+static void s_on_head_make(void *data, zwlr_output_head_v1 *, const char *make)
+{
+    ((wlroots::head *)data)->make = make;
+}
+
+static void
+s_on_head_model(void *data, zwlr_output_head_v1 *, const char *model)
+{
+    ((wlroots::head *)data)->model = model;
+}
+
+static void s_on_head_serial_number(void *data,
+                                    zwlr_output_head_v1 *,
+                                    const char *serial_number)
+{
+    ((wlroots::head *)data)->serial_number = serial_number;
+}
+
+static const zwlr_output_head_v1_listener s_head_listener = {
+    .name = s_on_head_name,
+    .description = s_on_head_description,
+    .physical_size = s_on_head_physical_size,
+    .mode = s_on_head_mode,
+    .enabled = s_on_head_enabled,
+    .current_mode = s_on_head_current_mode,
+    .position = s_on_head_position,
+    .transform = s_on_head_transform,
+    .scale = s_on_head_scale,
+    .finished = s_on_head_finished,
+    .make = s_on_head_make,
+    .model = s_on_head_model,
+    .serial_number = s_on_head_serial_number,
+};
+
+static void s_on_manager_head(void *data,
+                              zwlr_output_manager_v1 *,
+                              zwlr_output_head_v1 *handle)
+{
+    auto *sess = (wlroots::session *)data;
+
+    auto head = std::make_unique<wlroots::head>();
+    head->handle = handle;
+    head->sess = sess;
+    zwlr_output_head_v1_add_listener(handle, &s_head_listener, head.get());
+
+    sess->heads.push_back(std::move(head));
+}
+
+static void
+s_on_manager_done(void *data, zwlr_output_manager_v1 *, uint32_t serial)
+{
+    auto *sess = (wlroots::session *)data;
+    sess->serial = serial;
+    sess->done = true;
+}
+
+static void s_on_manager_finished(void *data, zwlr_output_manager_v1 *manager)
+{
+    auto *sess = (wlroots::session *)data;
+    zwlr_output_manager_v1_destroy(manager);
+    sess->manager = nullptr;
+}
+
+static const zwlr_output_manager_v1_listener s_manager_listener = {
+    .head = s_on_manager_head,
+    .done = s_on_manager_done,
+    .finished = s_on_manager_finished,
+};
+
+static void s_on_global(void *data,
+                        wl_registry *registry,
+                        uint32_t name,
+                        const char *interface,
+                        uint32_t version)
+{
+    auto *sess = (wlroots::session *)data;
+
+    if (sess->manager ||
+        std::string_view(interface) != zwlr_output_manager_v1_interface.name)
+        return;
+
+    sess->version = std::min(version, max_version);
+    sess->manager = (zwlr_output_manager_v1 *)wl_registry_bind(
+        registry, name, &zwlr_output_manager_v1_interface, sess->version);
+    zwlr_output_manager_v1_add_listener(
+        sess->manager, &s_manager_listener, sess);
+}
+
+static void s_on_global_remove(void *, wl_registry *, uint32_t)
+{
+}
+
+static const wl_registry_listener s_registry_listener = {
+    .global = s_on_global,
+    .global_remove = s_on_global_remove,
+};
+
+namespace
+{
+
+enum class result
+{
+    PENDING,
+    SUCCEEDED,
+    FAILED,
+    CANCELLED,
+};
+
+} // namespace
+
+static void s_on_succeeded(void *data, zwlr_output_configuration_v1 *)
+{
+    *(result *)data = result::SUCCEEDED;
+}
+
+static void s_on_failed(void *data, zwlr_output_configuration_v1 *)
+{
+    *(result *)data = result::FAILED;
+}
+
+static void s_on_cancelled(void *data, zwlr_output_configuration_v1 *)
+{
+    *(result *)data = result::CANCELLED;
+}
+
+static const zwlr_output_configuration_v1_listener s_configuration_listener = {
+    .succeeded = s_on_succeeded,
+    .failed = s_on_failed,
+    .cancelled = s_on_cancelled,
+};
+
+static void s_configure_head(zwlr_output_configuration_v1 *configuration,
+                             const wlroots::head &head,
+                             const head_config &config)
+{
+    if (!config.want)
+    {
+        zwlr_output_configuration_v1_disable_head(configuration, head.handle);
+        return;
+    }
+
+    const display::state &want = *config.want;
+
+    zwlr_output_configuration_head_v1 *configuration_head =
+        zwlr_output_configuration_v1_enable_head(configuration, head.handle);
+
+    if (config.mode)
+        zwlr_output_configuration_head_v1_set_mode(configuration_head,
+                                                   config.mode->handle);
+    else if (want.mode.width > 0 && want.mode.height > 0)
+        zwlr_output_configuration_head_v1_set_custom_mode(
+            configuration_head,
+            want.mode.width,
+            want.mode.height,
+            (int32_t)(want.mode.rate * 1000));
+
+    zwlr_output_configuration_head_v1_set_position(
+        configuration_head, want.position.x, want.position.y);
+    zwlr_output_configuration_head_v1_set_transform(
+        configuration_head, s_rotation_to_transform(want.rotation));
+}
+
+namespace wlroots
+{
+
+std::unique_ptr<session> session::connect()
+{
+    if (!std::getenv("WAYLAND_DISPLAY"))
+        return nullptr;
+
+    wl_display *display = wl_display_connect(nullptr);
+    if (!display)
+        return nullptr;
+
+    auto result = std::make_unique<session>(display);
+    if (!result->manager)
+        return nullptr;
 
     return result;
 }
 
-static std::unordered_map<std::string, std::vector<uint8_t>> s_list_edids()
+session::session(wl_display *_display) : display(_display)
+{
+    stats::scope scope(stats::phase::CONNECT);
+
+    registry = wl_display_get_registry(display);
+    wl_registry_add_listener(registry, &s_registry_listener, this);
+    wl_display_roundtrip(display);
+    stats::record(2, 1, 0);
+
+    if (!manager)
+        return;
+
+    stats::scope probe(stats::phase::PROBE);
+    while (manager && !done)
+        dispatch();
+}
+
+session::~session()
+{
+    for (std::unique_ptr<head> &head : heads)
+    {
+        for (std::unique_ptr<mode> &mode : head->modes)
+            zwlr_output_mode_v1_destroy(mode->handle);
+        zwlr_output_head_v1_destroy(head->handle);
+    }
+
+    if (manager)
+        zwlr_output_manager_v1_destroy(manager);
+    wl_registry_destroy(registry);
+    wl_display_disconnect(display);
+}
+
+void session::dispatch()
+{
+    stats::record(0, 1, 0);
+    if (wl_display_dispatch(display) == -1)
+        throw common::exception("Lost the connection to the compositor.");
+}
+
+void session::outputs(std::pmr::vector<display::output> &result)
 {
-    std::unordered_map<std::string, std::vector<uint8_t>> result;
+    stats::scope scope(stats::phase::EDID);
 
-    for (const auto &entry :
-         std::filesystem::directory_iterator("/sys/class/drm"))
+    std::unordered_map<std::string, std::vector<uint8_t>> sysfs =
+        edids::list_sysfs();
+
+    result.reserve(heads.size());
+    for (const std::unique_ptr<head> &head : heads)
     {
-        std::filesystem::path path = entry.path();
-        std::filesystem::path edid_path = path / "edid";
+        display::output &output = result.emplace_back();
+
+        output.name = head->name;
+        s_head_edid(*head, sysfs, output.edid);
+        // The compositor only lists heads with a display attached.
+        output.is_connected = true;
+        output.is_active = head->enabled;
+        output.position = {(unsigned int)std::max(head->x, 0),
+                           (unsigned int)std::max(head->y, 0)};
+        output.rotation = s_transform_to_rotation(head->transform, head->name);
+
+        output.modes.reserve(head->modes.size());
+        for (size_t i = 0; i < head->modes.size(); ++i)
+        {
+            if (head->modes[i].get() == head->current_mode)
+                output.mode_index = i;
+            s_to_mode(*head->modes[i], output.modes.emplace_back());
+        }
+    }
+}
+
+std::string session::plan(const digest::map<display::state> &outputs)
+{
+    std::unordered_map<std::string, std::vector<uint8_t>> sysfs =
+        edids::list_sysfs();
+    std::ostringstream oss;
+
+    stats::scope scope(stats::phase::PLAN);
+
+    display::state fallback;
+    std::vector<head_config> configs =
+        s_head_configs(heads, outputs, sysfs, fallback);
+
+    for (size_t i = 0; i < heads.size(); ++i)
+    {
+        const std::unique_ptr<head> &head = heads[i];
+        const head_config &config = configs[i];
+
+        if (s_is_unchanged(*head, config))
+            continue;
 
-        if (!std::filesystem::exists(edid_path))
+        oss << "head " << head->name;
+
+        if (!config.want)
+        {
+            oss << " disable\n";
             continue;
+        }
+
+        const display::state &want = *config.want;
+
+        if (config.mode)
+            oss << " mode=" << config.mode->width << "x"
+                << config.mode->height << "@" << config.mode->refresh / 1000.0;
+        else if (want.mode.width > 0 && want.mode.height > 0)
+            oss << " mode=" << want.mode.width << "x" << want.mode.height
+                << "@" << want.mode.rate << " custom";
+
+        oss << " x=" << want.position.x << " y=" << want.position.y;
+        oss << " rotation="
+            << s_transform_name(s_rotation_to_transform(want.rotation));
+        oss << "\n";
+    }
+
+    return oss.str();
+}
+
+void session::apply(const digest::map<display::state> &outputs)
+{
+    std::unordered_map<std::string, std::vector<uint8_t>> sysfs =
+        edids::list_sysfs();
+
+    stats::scope scope(stats::phase::APPLY);
+
+    // A configuration can only be tested or applied once, so the tested
+    // layout is sent again to apply it. A cancelled configuration raced a
+    // change in the compositor's state; it's retried against the new state.
+    for (bool test : {true, false})
+    {
+        result outcome = result::CANCELLED;
+
+        for (int attempt = 0; attempt < 2 && outcome == result::CANCELLED;
+             ++attempt)
+        {
+            if (!manager)
+                throw common::exception("The compositor stopped output "
+                                        "management.");
+
+            uint32_t used_serial = serial;
+            zwlr_output_configuration_v1 *configuration =
+                zwlr_output_manager_v1_create_configuration(manager, serial);
+            outcome = result::PENDING;
+            zwlr_output_configuration_v1_add_listener(
+                configuration, &s_configuration_listener, &outcome);
+
+            display::state fallback;
+            std::vector<head_config> configs =
+                s_head_configs(heads, outputs, sysfs, fallback);
+            for (size_t i = 0; i < heads.size(); ++i)
+                s_configure_head(configuration, *heads[i], configs[i]);
 
-        std::string basename = path.filename();
+            if (test)
+                zwlr_output_configuration_v1_test(configuration);
+            else
+                zwlr_output_configuration_v1_apply(configuration);
+            stats::record(heads.size() * 4 + 2, 0, 0);
 
-        const auto dash = basename.find('-');
+            while (outcome == result::PENDING)
+                dispatch();
 
-        if (dash == std::string::npos)
-            throw common::exception("Unexpected name in /sys/class/drm");
+            zwlr_output_configuration_v1_destroy(configuration);
 
-        std::string name = basename.substr(dash + 1);
+            while (outcome == result::CANCELLED && manager &&
+                   serial == used_serial)
+                dispatch();
+        }
 
-        result[name] = s_read_binary(edid_path);
+        if (outcome != result::SUCCEEDED)
+            throw common::exception(
+                test ? "The compositor rejected the display configuration."
+                     : "Failed to apply display configuration.");
     }
 
+    // Pick up the new state if the compositor has already sent it.
+    stats::record(1, 1, 0);
+    wl_display_roundtrip(display);
+}
+
+std::vector<digest::sha256> session::connected_edids() const
+{
+    std::unordered_map<std::string, std::vector<uint8_t>> sysfs =
+        edids::list_sysfs();
+
+    std::vector<digest::sha256> result;
+    result.reserve(heads.size());
+    for (const std::unique_ptr<head> &head : heads)
+    {
+        display::edid edid;
+        s_head_edid(*head, sysfs, edid);
+        result.push_back(edid.digest);
+    }
+
+    std::sort(result.begin(), result.end());
     return result;
 }
 
-static void s_on_new_output_callback(wl_listener *listener, void *data) {}
+void session::wait(int settle_ms)
+{
+    // Every change the compositor makes ends with a done event.
+    done = false;
+    while (manager && !done)
+        dispatch();
+
+    // Docks add and remove heads in a burst for one plug; keep absorbing
+    // them until the compositor stays quiet for the settle time.
+    pollfd fd = {.fd = wl_display_get_fd(display), .events = POLLIN};
+
+    while (manager)
+    {
+        wl_display_flush(display);
+        if (poll(&fd, 1, settle_ms) <= 0)
+            break;
+        dispatch();
+    }
+
+    if (!manager)
+        throw common::exception("The compositor stopped output management.");
+}
+
+} // namespace wlroots
 
-} // namespace display
+static std::unique_ptr<module::connection>
+connect_wlroots(const module::options &)
+{
+    return wlroots::session::connect();
+}
+
+static void watch_wlroots(const module::options &,
+                          const display::layout_selector &select,
+                          int settle_ms)
+{
+    std::unique_ptr<wlroots::session> sess = wlroots::session::connect();
+    if (!sess)
+        return;
+
+    std::optional<std::vector<digest::sha256>> applied;
+
+    while (true)
+    {
+        std::vector<digest::sha256> connected = sess->connected_edids();
+
+        if (connected != applied)
+        {
+            applied = connected;
+
+            auto outputs = select(connected);
+
+            if (outputs)
+            {
+                try
+                {
+                    sess->apply(*outputs);
+                }
+                catch (const std::exception &e)
+                {
+                    std::cerr << "Warning: " << e.what() << std::endl;
+                }
+            }
+        }
+
+        sess->wait(settle_ms);
+    }
+}
+
+extern "C" const module::interface dman_module = {
+    .connect = connect_wlroots,
+    .watch = watch_wlroots,
+};
@@ -0,0 +1,558 @@
+#include "module.hpp"
+#include "backend.hpp"
+#include "edid.hpp"
+#include "modes.hpp"
+#include "x11.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <dman/edid.hpp>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+static display::rotation x11_rotation_to_rotation(Rotation rotation,
+                                                  const std::string &name)
+{
+    switch (rotation)
+    {
+    case RR_Rotate_0:
+        return display::rotation::NORMAL;
+    case RR_Rotate_90:
+        return display::rotation::RIGHT;
+    case RR_Rotate_180:
+        return display::rotation::INVERTED;
+    case RR_Rotate_270:
+        return display::rotation::LEFT;
+    default:
+        std::cerr << "Warning: Unknown rotation value " << rotation
+                  << " for output " << name << std::endl;
+        return display::rotation::NORMAL;
+    }
+}
+
+static bool set_crtc_info(display::output &output,
+                          const x11::snapshot &snapshot,
+                          const x11::snapshot::output &info)
+{
+    const x11::snapshot::crtc *crtc = snapshot.find_crtc(info.crtc);
+    if (!crtc)
+    {
+        std::cerr << "Warning: CRTC info not found for output " << info.name
+                  << std::endl;
+        return false;
+    }
+    output.is_active = (crtc->mode != None);
+    const x11::snapshot::mode *mode = snapshot.find_mode(crtc->mode);
+    if (!mode)
+    {
+        std::cerr << "Warning: Mode ID " << crtc->mode
+                  << " not found in resources." << std::endl;
+        return false;
+    }
+    output.mode_index = modes::get_mode_index(
+        output.modes, modes::calc_mode_from_info(snapshot, *mode));
+    output.position.x = crtc->x;
+    output.position.y = crtc->y;
+    output.rotation = x11_rotation_to_rotation(crtc->rotation, info.name);
+
+    return true;
+}
+
+static bool decode_edid(const x11::snapshot::output &info, display::edid &edid)
+{
+    stats::scope scope(stats::phase::EDID);
+
+    if (info.edid.empty())
+    {
+        std::cerr << "Warning: No EDID available." << std::endl;
+        return false;
+    }
+
+    if (info.edid.size() < 128)
+    {
+        std::cerr << "Warning: EDID data too small (" << info.edid.size()
+                  << " bytes)." << std::endl;
+        return false;
+    }
+
+    if (!display::edid_view(info.edid.data(), info.edid.size()).valid())
+    {
+        std::cerr << "Warning: EDID data has no EDID header." << std::endl;
+        return false;
+    }
+
+    edid = edids::decode(info.edid);
+    return true;
+}
+
+void x11::to_output(const x11::snapshot &snapshot,
+                    const x11::snapshot::output &info,
+                    display::output &output)
+{
+    output.name = info.name;
+    output.is_primary = (info.id == snapshot.primary);
+    if (info.connection != RR_Connected)
+        return;
+
+    output.modes.reserve(info.modes.size());
+    for (RRMode mode_id : info.modes)
+    {
+        const x11::snapshot::mode *mode = snapshot.find_mode(mode_id);
+
+        if (!mode)
+        {
+            std::cerr << "Warning: Mode ID " << mode_id
+                      << " not found in resources." << std::endl;
+            continue;
+        }
+
+        output.modes.emplace_back(modes::calc_mode_from_info(snapshot, *mode));
+    }
+
+    if (info.crtc)
+    {
+        if (!set_crtc_info(output, snapshot, info))
+        {
+            std::cerr << "Warning: Failed to set CRTC info for output "
+                      << info.name << std::endl;
+        }
+    }
+
+    // Without an EDID there's nothing to tell the display apart by.
+    output.is_connected = decode_edid(info, output.edid);
+
+    output.is_tearfree = info.tearfree;
+}
+
+static Rotation rotation_to_x11_rotation(display::rotation rotation)
+{
+    switch (rotation)
+    {
+    case display::rotation::NORMAL:
+        return RR_Rotate_0;
+    case display::rotation::LEFT:
+        return RR_Rotate_270;
+    case display::rotation::RIGHT:
+        return RR_Rotate_90;
+    case display::rotation::INVERTED:
+        return RR_Rotate_180;
+    default:
+        return RR_Rotate_0;
+    }
+}
+
+static display::vec2<uint32_t> get_rotated_size(const display::state &state)
+{
+    if (state.rotation == display::rotation::LEFT ||
+        state.rotation == display::rotation::RIGHT)
+        return {state.mode.height, state.mode.width};
+    return {state.mode.width, state.mode.height};
+}
+
+static display::vec2<int32_t> get_total_screen_size(
+    const digest::map<display::state> &outputs)
+{
+    display::vec2<uint32_t> max{0, 0};
+
+    for (const auto &[name, state] : outputs)
+    {
+        if (!state.is_active)
+            continue;
+
+        display::vec2<uint32_t> size = get_rotated_size(state);
+
+        display::vec2<uint32_t> bottom_right = state.position + size;
+
+        if (max.x < bottom_right.x)
+            max.x = bottom_right.x;
+        if (max.y < bottom_right.y)
+            max.y = bottom_right.y;
+    }
+
+    return {(int32_t)max.x, (int32_t)max.y};
+}
+
+static display::vec2<int32_t>
+get_min(const digest::map<display::state> &outputs)
+{
+    int32_t min_x = INT32_MAX;
+    int32_t min_y = INT32_MAX;
+
+    for (const auto &[name, state] : outputs)
+    {
+        if (!state.is_active)
+            continue;
+
+        if (state.position.x < min_x)
+            min_x = state.position.x;
+        if (state.position.y < min_y)
+            min_y = state.position.y;
+    }
+
+    if (min_x == INT32_MAX)
+        min_x = 0;
+    if (min_y == INT32_MAX)
+        min_y = 0;
+
+    return {min_x, min_y};
+}
+
+static RRMode find_smallest_mode(const x11::snapshot &snapshot,
+                                 const x11::snapshot::output &info)
+{
+    RRMode smallest_mode = None;
+    double smallest_volume = INFINITY;
+
+    for (RRMode mode_id : info.modes)
+    {
+        const x11::snapshot::mode *mode_info = snapshot.find_mode(mode_id);
+        if (!mode_info)
+            continue;
+        double volume = (double)mode_info->width *
+                        (double)mode_info->height * mode_info->rate.value();
+        if (volume < smallest_volume)
+        {
+            smallest_volume = volume;
+            smallest_mode = mode_id;
+        }
+    }
+    return smallest_mode;
+}
+
+// The mode the EDID asks for: its preferred timing exactly, else one at the
+// panel's native size.
+static RRMode find_preferred_mode(const x11::snapshot &snapshot,
+                                  const x11::snapshot::output &info)
+{
+    display::edid_view view(info.edid.data(), info.edid.size());
+    std::optional<display::detailed_timing> preferred =
+        view.preferred_timing();
+    if (!preferred)
+        return None;
+
+    display::timing timing = preferred->timing();
+    for (RRMode mode_id : info.modes)
+    {
+        const x11::snapshot::mode *mode = snapshot.find_mode(mode_id);
+        if (mode && mode->timing() == timing)
+            return mode_id;
+    }
+
+    std::optional<display::vec2<unsigned int>> native =
+        view.native_resolution();
+    for (RRMode mode_id : info.modes)
+    {
+        const x11::snapshot::mode *mode = snapshot.find_mode(mode_id);
+        if (mode && native && mode->width == native->x &&
+            mode->height == native->y)
+            return mode_id;
+    }
+
+    return None;
+}
+
+static bool leaves_one_display_active(const x11::snapshot &snapshot,
+                                      const x11::layout &layout)
+{
+    for (const x11::crtc_config &config : layout.crtcs)
+    {
+        if (config.mode != None)
+            return true;
+    }
+
+    for (const x11::snapshot::crtc &crtc : snapshot.crtcs)
+    {
+        if (crtc.mode == None)
+            continue;
+
+        bool disabled = false;
+        for (const x11::crtc_config &config : layout.crtcs)
+            disabled = disabled || config.crtc == crtc.id;
+
+        if (!disabled)
+            return true;
+    }
+
+    return false;
+}
+
+static void ensure_one_display_is_active(const x11::snapshot &snapshot,
+                                         x11::layout &layout)
+{
+    if (leaves_one_display_active(snapshot, layout))
+        return;
+
+    std::cerr << "Warning: No active display found. Activating the first "
+                 "connected display."
+              << std::endl;
+
+    for (const x11::snapshot::output &info : snapshot.outputs)
+    {
+        if (info.connection != RR_Connected || info.modes.empty())
+            continue;
+
+        RRMode mode_id = find_preferred_mode(snapshot, info);
+        if (mode_id == None)
+            mode_id = find_smallest_mode(snapshot, info);
+        const x11::snapshot::mode *mode = snapshot.find_mode(mode_id);
+        if (!mode)
+            continue;
+
+        RRCrtc crtc = x11::assign_crtcs(snapshot, {info.id}).front();
+        if (crtc == None)
+            continue;
+        std::erase_if(layout.crtcs,
+                      [&](const x11::crtc_config &config)
+                      { return config.crtc == crtc; });
+
+        layout.crtcs.push_back(x11::crtc_config{
+            .crtc = crtc,
+            .mode = mode_id,
+            .outputs = {info.id},
+            .width = mode->width,
+            .height = mode->height,
+        });
+        return;
+    }
+}
+
+static const display::state *
+find_wanted_state(const digest::map<display::state> &outputs,
+                  const x11::snapshot::output &info)
+{
+    if (info.connection != RR_Connected ||
+        !display::edid_view(info.edid.data(), info.edid.size()).valid())
+        return nullptr;
+
+    const auto &it = outputs.find(edids::decode(info.edid).digest);
+
+    if (it == outputs.end() || !it->second.is_active)
+        return nullptr;
+
+    return &it->second;
+}
+
+static x11::layout
+build_layout(const digest::map<display::state> &outputs,
+             const x11::snapshot &snapshot)
+{
+    x11::layout layout;
+
+    display::vec2<int32_t> min_position = get_min(outputs);
+
+    std::vector<const x11::snapshot::output *> enabled;
+    std::vector<const display::state *> wanted;
+    std::vector<RROutput> enabled_ids;
+    for (const x11::snapshot::output &info : snapshot.outputs)
+    {
+        if (const display::state *want = find_wanted_state(outputs, info))
+        {
+            enabled.push_back(&info);
+            wanted.push_back(want);
+            enabled_ids.push_back(info.id);
+        }
+    }
+
+    // Every CRTC is placed before any is configured, so one output taking
+    // the only CRTC another can use never makes the server refuse a
+    // modeset.
+    std::vector<RRCrtc> crtcs = x11::assign_crtcs(snapshot, enabled_ids);
+
+    for (size_t i = 0; i < enabled.size(); ++i)
+    {
+        const x11::snapshot::output &info = *enabled[i];
+        const display::state *want = wanted[i];
+
+        if (crtcs[i] == None)
+            throw std::runtime_error("No CRTC can drive output " + info.name +
+                                     ".");
+
+        display::vec2<uint32_t> size = get_rotated_size(*want);
+
+        layout.crtcs.push_back(x11::crtc_config{
+            .crtc = crtcs[i],
+            .x = (int)want->position.x - min_position.x,
+            .y = (int)want->position.y - min_position.y,
+            .mode = modes::find_mode_id_by_info(snapshot, info, want->mode),
+            .rotation = rotation_to_x11_rotation(want->rotation),
+            .outputs = {info.id},
+            .width = size.x,
+            .height = size.y,
+        });
+
+        if (want->is_primary)
+            layout.primary = info.id;
+
+        if (want->is_tearfree != display::tearfree::UNSET)
+            layout.tearfree.emplace_back(info.id, want->is_tearfree);
+    }
+
+    x11::disable_unused_crtcs(snapshot, layout);
+
+    static constexpr size_t pixels_per_milimeter = 3;
+    display::vec2<int32_t> total_size =
+        get_total_screen_size(outputs) - min_position;
+
+    if (total_size.x > 0 && total_size.y > 0)
+    {
+        layout.screen_size = {(unsigned int)total_size.x,
+                              (unsigned int)total_size.y};
+        layout.screen_size_mm = {
+            (unsigned int)(total_size.x / pixels_per_milimeter),
+            (unsigned int)(total_size.y / pixels_per_milimeter)};
+    }
+    else
+    {
+        std::cerr << "Warning: Total screen size is zero; not setting screen "
+                     "size."
+                  << std::endl;
+    }
+
+    ensure_one_display_is_active(snapshot, layout);
+
+    return layout;
+}
+
+// A dry run only reads the cache; a layout that's applied is stored for
+// next time.
+static x11::layout plan_layout(const digest::map<display::state> &outputs,
+                               const x11::snapshot &snapshot,
+                               const x11::plan_cache &cache,
+                               bool store)
+{
+    stats::scope scope(stats::phase::PLAN);
+
+    digest::sha256 key = x11::plan_cache::key(outputs, snapshot);
+
+    std::optional<x11::layout> layout = cache.load(key, snapshot);
+    if (!layout)
+    {
+        layout = build_layout(outputs, snapshot);
+        if (store)
+            cache.store(key, *layout);
+    }
+
+    return x11::diff(snapshot, *layout);
+}
+
+static std::vector<digest::sha256>
+get_connected_edids(const x11::snapshot &snapshot)
+{
+    std::vector<digest::sha256> result;
+
+    for (const x11::snapshot::output &info : snapshot.outputs)
+    {
+        if (info.connection == RR_Connected &&
+            display::edid_view(info.edid.data(), info.edid.size()).valid())
+            result.push_back(edids::decode(info.edid).digest);
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+namespace
+{
+
+class randr_connection : public module::connection
+{
+    std::unique_ptr<backend::randr> randr;
+    x11::plan_cache cache;
+    x11::snapshot snapshot;
+    bool stale = true;
+
+    const x11::snapshot &current()
+    {
+        if (stale)
+        {
+            snapshot = randr->probe();
+            stale = false;
+        }
+        return snapshot;
+    }
+
+  public:
+    explicit randr_connection(const module::options &options)
+        : randr(backend::open(options)), cache(options)
+    {
+    }
+
+    void outputs(std::pmr::vector<display::output> &result) override
+    {
+        const x11::snapshot &snapshot = current();
+
+        result.reserve(snapshot.outputs.size());
+        for (const x11::snapshot::output &info : snapshot.outputs)
+            x11::to_output(snapshot, info, result.emplace_back());
+    }
+
+    std::string plan(const digest::map<display::state> &outputs) override
+    {
+        const x11::snapshot &snapshot = current();
+        return plan_layout(outputs, snapshot, cache, false)
+            .describe(snapshot);
+    }
+
+    void apply(const digest::map<display::state> &outputs) override
+    {
+        const x11::snapshot &snapshot = current();
+        x11::layout layout = plan_layout(outputs, snapshot, cache, true);
+
+        stale = true;
+        randr->commit(snapshot, layout);
+    }
+};
+
+} // namespace
+
+static std::unique_ptr<module::connection>
+connect_randr(const module::options &options)
+{
+    return std::make_unique<randr_connection>(options);
+}
+
+static void watch_randr(const module::options &options,
+                        const display::layout_selector &select,
+                        int settle_ms)
+{
+    x11::session x11;
+    x11::plan_cache cache(options);
+    x11::snapshot snapshot(x11, options.probe_hardware);
+    x11::watcher watcher(x11, snapshot);
+
+    std::optional<std::vector<digest::sha256>> applied;
+
+    while (true)
+    {
+        std::vector<digest::sha256> connected = get_connected_edids(snapshot);
+
+        if (connected != applied)
+        {
+            applied = connected;
+
+            auto outputs = select(connected);
+
+            if (outputs)
+            {
+                try
+                {
+                    x11::transaction transaction(x11, snapshot);
+                    transaction.commit(
+                        plan_layout(*outputs, snapshot, cache, true));
+                }
+                catch (const std::exception &e)
+                {
+                    std::cerr << "Warning: " << e.what() << std::endl;
+                }
+            }
+        }
+
+        watcher.wait(settle_ms);
+    }
+}
+
+extern "C" const module::interface dman_module = {
+    .connect = connect_randr,
+    .watch = watch_randr,
+};
@@ -0,0 +1,412 @@
+#include <dman/edid.hpp>
+
+#include <X11/extensions/randr.h>
+#include <cstring>
+
+static constexpr size_t block_size = 128;
+
+static constexpr uint8_t edid_header[8] = {
+    0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+
+// Base block layout.
+static constexpr size_t features_offset = 0x18;
+static constexpr size_t descriptors_offset = 54;
+static constexpr size_t descriptor_size = 18;
+static constexpr size_t descriptor_count = 4;
+static constexpr size_t extension_count_offset = 126;
+
+static constexpr uint8_t monitor_name_tag = 0xFC;
+static constexpr uint8_t range_limits_tag = 0xFD;
+
+// Extension tags.
+static constexpr uint8_t cta_tag = 0x02;
+static constexpr uint8_t displayid_tag = 0x70;
+
+// CTA-861 data blocks.
+static constexpr uint8_t cta_vendor_block = 3;
+static constexpr uint8_t hdmi_forum_oui[3] = {0xD8, 0x5D, 0xC4};
+
+// DisplayID data blocks. Type VII timings and the 2.0 display parameters
+// share the layout of their 1.3 counterparts.
+static constexpr uint8_t displayid_parameters = 0x01;
+static constexpr uint8_t displayid_type_1_timing = 0x03;
+static constexpr uint8_t displayid_parameters_2 = 0x21;
+static constexpr uint8_t displayid_type_7_timing = 0x22;
+static constexpr size_t displayid_blocks_offset = 5;
+static constexpr size_t displayid_timing_size = 20;
+
+static uint16_t le16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t le24(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16;
+}
+
+static std::optional<display::detailed_timing>
+decode_descriptor_timing(const uint8_t *p)
+{
+    uint16_t clock = le16(p);
+    if (clock == 0)
+        return std::nullopt;
+
+    // Like the kernel and the X server, bits 1 and 2 are read as the
+    // polarities whatever the sync type.
+    return display::detailed_timing{
+        .pixel_clock = clock * 10u,
+        .h_active = (uint16_t)(p[2] | (p[4] & 0xF0) << 4),
+        .h_blank = (uint16_t)(p[3] | (p[4] & 0x0F) << 8),
+        .h_sync_offset = (uint16_t)(p[8] | (p[11] & 0xC0) << 2),
+        .h_sync_width = (uint16_t)(p[9] | (p[11] & 0x30) << 4),
+        .v_active = (uint16_t)(p[5] | (p[7] & 0xF0) << 4),
+        .v_blank = (uint16_t)(p[6] | (p[7] & 0x0F) << 8),
+        .v_sync_offset = (uint16_t)(p[10] >> 4 | (p[11] & 0x0C) << 2),
+        .v_sync_width = (uint16_t)((p[10] & 0x0F) | (p[11] & 0x03) << 4),
+        .interlaced = (p[17] & 0x80) != 0,
+        .h_sync_positive = (p[17] & 0x02) != 0,
+        .v_sync_positive = (p[17] & 0x04) != 0,
+    };
+}
+
+// Fields are stored minus one; the top bit of each sync offset is its
+// polarity.
+static display::detailed_timing decode_displayid_timing(const uint8_t *p,
+                                                        bool khz)
+{
+    uint32_t clock = le24(p) + 1;
+
+    return display::detailed_timing{
+        .pixel_clock = khz ? clock : clock * 10,
+        .h_active = (uint16_t)(le16(p + 4) + 1),
+        .h_blank = (uint16_t)(le16(p + 6) + 1),
+        .h_sync_offset = (uint16_t)((le16(p + 8) & 0x7FFF) + 1),
+        .h_sync_width = (uint16_t)(le16(p + 10) + 1),
+        .v_active = (uint16_t)(le16(p + 12) + 1),
+        .v_blank = (uint16_t)(le16(p + 14) + 1),
+        .v_sync_offset = (uint16_t)((le16(p + 16) & 0x7FFF) + 1),
+        .v_sync_width = (uint16_t)(le16(p + 18) + 1),
+        .interlaced = (p[3] & 0x10) != 0,
+        .h_sync_positive = (p[9] & 0x80) != 0,
+        .v_sync_positive = (p[17] & 0x80) != 0,
+        .preferred = (p[3] & 0x80) != 0,
+    };
+}
+
+// The CTA-861 data block collection runs up to the first detailed timing.
+static size_t cta_timings_offset(const uint8_t *block)
+{
+    size_t offset = block[2];
+    return offset < 4 || offset >= block_size ? block_size : offset;
+}
+
+// Calls `visit` with each CTA-861 data block's tag and bytes, header
+// included, until it returns true.
+template <typename F>
+static bool for_each_cta_block(const uint8_t *block, F visit)
+{
+    size_t end = cta_timings_offset(block);
+
+    for (size_t i = 4; i < end;)
+    {
+        size_t length = block[i] & 0x1F;
+        if (i + 1 + length > end)
+            break;
+        if (visit(block[i] >> 5, block + i, length))
+            return true;
+        i += 1 + length;
+    }
+    return false;
+}
+
+// Calls `visit` with each DisplayID data block's tag, payload and payload
+// length until it returns true.
+template <typename F>
+static bool for_each_displayid_block(const uint8_t *block, F visit)
+{
+    size_t end = std::min(displayid_blocks_offset + block[2], block_size - 1);
+
+    for (size_t i = displayid_blocks_offset; i + 3 <= end;)
+    {
+        size_t length = block[i + 2];
+        if (i + 3 + length > end)
+            break;
+        if (visit(block[i], block + i + 3, length))
+            return true;
+        i += 3 + length;
+    }
+    return false;
+}
+
+display::timing display::detailed_timing::timing() const
+{
+    struct timing result = {
+        .dot_clock = (uint64_t)pixel_clock * 1000,
+        .h_total = (uint32_t)h_active + h_blank,
+        .v_total = (uint32_t)v_active + v_blank,
+        .flags = (uint32_t)(h_sync_positive ? RR_HSyncPositive
+                                            : RR_HSyncNegative) |
+                 (v_sync_positive ? RR_VSyncPositive : RR_VSyncNegative),
+    };
+
+    // Interlaced timings give one field; the server doubles it into a
+    // frame with an odd line count.
+    if (interlaced)
+    {
+        result.v_total = result.v_total * 2 | 1;
+        result.flags |= RR_Interlace;
+    }
+
+    return result;
+}
+
+namespace display
+{
+
+edid_view::edid_view(const void *_data, size_t _size)
+    : data((const uint8_t *)_data), size(_size)
+{
+}
+
+bool edid_view::valid() const
+{
+    return size >= block_size &&
+           std::memcmp(data, edid_header, sizeof(edid_header)) == 0;
+}
+
+size_t edid_view::block_count() const
+{
+    if (!valid())
+        return 0;
+    return std::min<size_t>(1 + data[extension_count_offset],
+                            size / block_size);
+}
+
+const uint8_t *edid_view::block(size_t index) const
+{
+    return index < block_count() ? data + index * block_size : nullptr;
+}
+
+std::array<char, 3> edid_view::manufacturer_id() const
+{
+    if (!valid())
+        return {};
+
+    uint16_t id = data[8] << 8 | data[9];
+    return {
+        (char)('A' - 1 + (id >> 10 & 0x1F)),
+        (char)('A' - 1 + (id >> 5 & 0x1F)),
+        (char)('A' - 1 + (id & 0x1F)),
+    };
+}
+
+uint16_t edid_view::product_code() const
+{
+    return valid() ? le16(data + 10) : 0;
+}
+
+uint32_t edid_view::serial_number() const
+{
+    return valid() ? le16(data + 12) | le16(data + 14) << 16 : 0;
+}
+
+std::string_view edid_view::monitor_name() const
+{
+    if (!valid())
+        return {};
+
+    for (size_t i = 0; i < descriptor_count; ++i)
+    {
+        const uint8_t *p = data + descriptors_offset + i * descriptor_size;
+        if (le16(p) != 0 || p[3] != monitor_name_tag)
+            continue;
+
+        // Up to 13 characters, ended by a line feed and padded with spaces.
+        std::string_view name((const char *)p + 5, descriptor_size - 5);
+        name = name.substr(0, name.find('\n'));
+        while (!name.empty() && name.back() == ' ')
+            name.remove_suffix(1);
+        return name;
+    }
+
+    return {};
+}
+
+std::optional<range_limits> edid_view::limits() const
+{
+    if (!valid())
+        return std::nullopt;
+
+    for (size_t i = 0; i < descriptor_count; ++i)
+    {
+        const uint8_t *p = data + descriptors_offset + i * descriptor_size;
+        if (le16(p) != 0 || p[3] != range_limits_tag)
+            continue;
+
+        // EDID 1.4 adds 255 to any rate whose offset flag is set.
+        uint8_t offsets = p[4];
+        return range_limits{
+            .min_v_rate = (uint16_t)(p[5] + (offsets & 0x01 ? 255 : 0)),
+            .max_v_rate = (uint16_t)(p[6] + (offsets & 0x02 ? 255 : 0)),
+            .min_h_rate = (uint16_t)(p[7] + (offsets & 0x04 ? 255 : 0)),
+            .max_h_rate = (uint16_t)(p[8] + (offsets & 0x08 ? 255 : 0)),
+            .max_pixel_clock = p[9] * 10000u,
+        };
+    }
+
+    return std::nullopt;
+}
+
+std::optional<detailed_timing> edid_view::next_timing(cursor &at) const
+{
+    for (; const uint8_t *b = block(at.block); ++at.block, at.offset = 0)
+    {
+        std::optional<detailed_timing> found;
+
+        if (at.block == 0)
+        {
+            for (size_t i = 0; i < descriptor_count && !found; ++i)
+            {
+                size_t offset = descriptors_offset + i * descriptor_size;
+                if (offset < at.offset)
+                    continue;
+                found = decode_descriptor_timing(b + offset);
+                if (found && i == 0)
+                    found->preferred = true;
+                at.offset = offset + 1;
+            }
+        }
+        else if (b[0] == cta_tag)
+        {
+            size_t offset = std::max(cta_timings_offset(b), at.offset);
+            if (offset < block_size - descriptor_size)
+            {
+                found = decode_descriptor_timing(b + offset);
+                at.offset = offset + descriptor_size;
+            }
+        }
+        else if (b[0] == displayid_tag)
+        {
+            for_each_displayid_block(
+                b, [&](uint8_t tag, const uint8_t *payload, size_t length) {
+                    if (tag != displayid_type_1_timing &&
+                        tag != displayid_type_7_timing)
+                        return false;
+
+                    for (size_t i = 0; i + displayid_timing_size <= length;
+                         i += displayid_timing_size)
+                    {
+                        size_t offset = payload + i - b;
+                        if (offset < at.offset)
+                            continue;
+                        found = decode_displayid_timing(
+                            payload + i, tag == displayid_type_7_timing);
+                        at.offset = offset + 1;
+                        return true;
+                    }
+                    return false;
+                });
+        }
+
+        if (found)
+            return found;
+    }
+
+    return std::nullopt;
+}
+
+std::optional<detailed_timing> edid_view::preferred_timing() const
+{
+    std::optional<detailed_timing> first;
+    cursor at;
+
+    while (std::optional<detailed_timing> timing = next_timing(at))
+    {
+        if (timing->preferred)
+            return timing;
+        if (!first)
+            first = timing;
+    }
+
+    return first;
+}
+
+std::optional<refresh_range> edid_view::vrr_range() const
+{
+    for (size_t i = 1; const uint8_t *b = block(i); ++i)
+    {
+        if (b[0] != cta_tag)
+            continue;
+
+        std::optional<refresh_range> found;
+        for_each_cta_block(
+            b, [&](uint8_t tag, const uint8_t *db, size_t length) {
+                if (tag != cta_vendor_block || length < 10 ||
+                    std::memcmp(db + 1, hdmi_forum_oui, 3) != 0)
+                    return false;
+
+                unsigned int min = db[9] & 0x3F;
+                unsigned int max = (db[9] & 0xC0) << 2 | db[10];
+                if (min == 0)
+                    return false;
+
+                found = refresh_range{min, max};
+                return true;
+            });
+
+        // A maximum of zero leaves it to the range limits.
+        if (found && found->max == 0)
+        {
+            std::optional<range_limits> range = limits();
+            found->max = range ? range->max_v_rate : 0;
+        }
+        if (found && found->max > found->min)
+            return found;
+    }
+
+    bool continuous = valid() && (data[features_offset] & 0x01);
+    std::optional<range_limits> range = limits();
+    if (continuous && range && range->max_v_rate > range->min_v_rate)
+        return refresh_range{range->min_v_rate, range->max_v_rate};
+
+    return std::nullopt;
+}
+
+std::optional<vec2<unsigned int>> edid_view::native_resolution() const
+{
+    for (size_t i = 1; const uint8_t *b = block(i); ++i)
+    {
+        if (b[0] != displayid_tag)
+            continue;
+
+        std::optional<vec2<unsigned int>> found;
+        for_each_displayid_block(
+            b, [&](uint8_t tag, const uint8_t *payload, size_t length) {
+                if ((tag != displayid_parameters &&
+                     tag != displayid_parameters_2) ||
+                    length < 8)
+                    return false;
+
+                vec2<unsigned int> size{le16(payload + 4), le16(payload + 6)};
+                if (size.x == 0 || size.y == 0)
+                    return false;
+
+                found = size;
+                return true;
+            });
+
+        if (found)
+            return found;
+    }
+
+    std::optional<detailed_timing> timing = preferred_timing();
+    if (!timing)
+        return std::nullopt;
+
+    return vec2<unsigned int>{timing->h_active,
+                              (unsigned int)timing->v_active *
+                                  (timing->interlaced ? 2 : 1)};
+}
+
+} // namespace display
@@ -0,0 +1,161 @@
+#include "edid.hpp"
+
+#include <dman/edid.hpp>
+#include <dman/exception.hpp>
+#include <cerrno>
+#include <filesystem>
+#include <string_view>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char drm_path[] = "/sys/class/drm";
+
+// Large enough for any EDID, including every extension block.
+static constexpr size_t edid_max_size = 32768;
+
+// Smaller than one block means no display; a base block can't be decoded.
+static constexpr size_t edid_block_size = 128;
+
+// Far more displays than one machine sees at once.
+static constexpr size_t decode_cache_size = 64;
+
+static std::vector<uint8_t> read_edid_file(const std::string &path)
+{
+    std::vector<uint8_t> result;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return result;
+
+    // sysfs reports no size for the file, so read until it runs out.
+    result.resize(edid_max_size);
+    size_t size = 0;
+
+    while (size < result.size())
+    {
+        ssize_t count = read(fd, result.data() + size, result.size() - size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        size += count;
+    }
+
+    close(fd);
+
+    // Some drivers expose a connector's EDID file with nothing but zeros.
+    result.resize(size);
+    if (!display::edid_view(result.data(), result.size()).valid())
+        result.clear();
+    return result;
+}
+
+// Connector directories are named after the card, as in card0-DP-1.
+static std::string connector_name(const std::string &basename)
+{
+    if (!basename.starts_with("card"))
+        return {};
+    size_t dash = basename.find('-');
+    if (dash == std::string::npos)
+        return {};
+    return basename.substr(dash + 1);
+}
+
+// The X modesetting driver names the kernel's HDMI-A-1 as HDMI-1; every
+// other connector type keeps the kernel's name.
+static bool names_connector(const std::string &kernel_name,
+                            const std::string &name)
+{
+    if (kernel_name == name)
+        return true;
+
+    static const std::string_view hdmi_a = "HDMI-A-";
+    return kernel_name.starts_with(hdmi_a) && name.starts_with("HDMI-") &&
+           std::string_view(kernel_name).substr(hdmi_a.size()) ==
+               std::string_view(name).substr(5);
+}
+
+namespace edids
+{
+
+std::vector<uint8_t> read_sysfs(const std::string &connector)
+{
+    std::vector<uint8_t> result;
+    std::error_code error;
+
+    for (const auto &entry :
+         std::filesystem::directory_iterator(drm_path, error))
+    {
+        std::string name = connector_name(entry.path().filename());
+        if (name.empty() || !names_connector(name, connector))
+            continue;
+
+        std::vector<uint8_t> edid = read_edid_file(entry.path() / "edid");
+        if (edid.empty())
+            continue;
+
+        // With a display on both card0-DP-1 and card1-DP-1, the connector
+        // name alone can't say which is meant.
+        if (!result.empty())
+            return {};
+        result = std::move(edid);
+    }
+
+    return result;
+}
+
+std::unordered_map<std::string, std::vector<uint8_t>> list_sysfs()
+{
+    std::unordered_map<std::string, std::vector<uint8_t>> result;
+    std::unordered_set<std::string> ambiguous;
+    std::error_code error;
+
+    for (const auto &entry :
+         std::filesystem::directory_iterator(drm_path, error))
+    {
+        std::string name = connector_name(entry.path().filename());
+        if (name.empty() || ambiguous.contains(name))
+            continue;
+
+        std::vector<uint8_t> edid = read_edid_file(entry.path() / "edid");
+        if (edid.empty())
+            continue;
+
+        // Named alike on two cards; neither can be matched to a head.
+        if (result.contains(name))
+        {
+            result.erase(name);
+            ambiguous.insert(std::move(name));
+            continue;
+        }
+
+        result.emplace(std::move(name), std::move(edid));
+    }
+
+    return result;
+}
+
+const display::edid &decode(const std::vector<uint8_t> &raw)
+{
+    static std::unordered_map<std::string, display::edid> decoded;
+
+    if (raw.size() < edid_block_size)
+        throw common::exception("EDID data too small.");
+
+    std::string key((const char *)raw.data(), raw.size());
+
+    auto it = decoded.find(key);
+    if (it != decoded.end())
+        return it->second;
+
+    // A daemon sees every display that is ever plugged in, so start over
+    // rather than keep them all.
+    if (decoded.size() >= decode_cache_size)
+        decoded.clear();
+
+    display::edid edid(raw.data(), raw.size());
+    return decoded.emplace(std::move(key), std::move(edid)).first->second;
+}
+
+} // namespace edids
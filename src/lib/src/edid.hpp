@@ -0,0 +1,35 @@
+#pragma once
+
+#include <dman/display.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Where EDIDs come from. X and Wayland each have their own way of reading
+// them, and DRM connectors expose them in sysfs; whichever way the bytes
+// arrive, each distinct EDID is hashed and decoded once per process, up to
+// a few dozen of them.
+//
+// Nothing is kept between runs: every invocation reads and hashes each
+// EDID again. sysfs keeps a connector's inode and mtime when another
+// display is plugged in and X has no per-property serial, so the bytes are
+// the only reliable key, and hashing a few hundred of them costs less than
+// opening a cache file to look them up.
+namespace edids
+{
+
+// The EDID of a DRM connector such as DP-1, or nothing when the connector
+// doesn't exist, has no display, or names displays on more than one card.
+// X's HDMI-1 also finds the kernel's HDMI-A-1.
+std::vector<uint8_t> read_sysfs(const std::string &connector);
+
+// The EDID of every DRM connector with a display, by connector name.
+// Names with a display on more than one card are left out.
+std::unordered_map<std::string, std::vector<uint8_t>> list_sysfs();
+
+// The decoded EDID for these bytes, which must be at least one block. The
+// reference is only good until the next call.
+const display::edid &decode(const std::vector<uint8_t> &raw);
+
+} // namespace edids
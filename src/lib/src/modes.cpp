@@ -0,0 +1,164 @@
+#include "modes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+display::rational_rate display::rational_rate::from(double rate)
+{
+    if (!(rate > 0))
+        return {};
+    return {(uint64_t)std::llround(rate * 1000), 1000};
+}
+
+double display::rational_rate::value() const
+{
+    return (double)numerator / denominator;
+}
+
+std::strong_ordering
+display::rational_rate::operator<=>(const rational_rate &other) const
+{
+    // Both sides fit easily: clocks and totals are well under 2^40.
+    return (unsigned __int128)numerator * other.denominator <=>
+           (unsigned __int128)other.numerator * denominator;
+}
+
+display::rational_rate display::timing::exact_rate() const
+{
+    uint64_t numerator = dot_clock;
+    uint64_t denominator = (uint64_t)h_total * v_total;
+    if (flags & RR_DoubleScan)
+        denominator *= 2;
+    if (flags & RR_Interlace)
+        numerator *= 2;
+
+    if (denominator == 0)
+        return {};
+
+    return {numerator, denominator};
+}
+
+bool display::mode::operator==(const display::mode &other) const
+{
+    if (width != other.width || height != other.height)
+        return false;
+
+    if (!timing.empty() && !other.timing.empty())
+        return timing == other.timing;
+
+    return std::fabs(rate - other.rate) < 1.5;
+}
+
+// The rate to search for: the exact one when the timing is known.
+static display::rational_rate wanted_rate(const display::mode &target_mode)
+{
+    return target_mode.timing.empty()
+               ? display::rational_rate::from(target_mode.rate)
+               : target_mode.timing.exact_rate();
+}
+
+// Whether `rate` is strictly nearer `below` than `above`, given
+// below <= rate <= above: 2 * rate < below + above, cross-multiplied.
+static bool nearer_below(const display::rational_rate &rate,
+                         const display::rational_rate &below,
+                         const display::rational_rate &above)
+{
+    using wide = unsigned __int128;
+    return 2 * (wide)rate.numerator * below.denominator * above.denominator <
+           ((wide)below.numerator * above.denominator +
+            (wide)above.numerator * below.denominator) *
+               rate.denominator;
+}
+
+namespace modes
+{
+
+display::mode calc_mode_from_info(const x11::snapshot &snapshot,
+                                  const x11::snapshot::mode &info)
+{
+    display::mode result;
+    result.name = snapshot.name(info);
+
+    result.width = info.width;
+    result.height = info.height;
+    result.timing = info.timing();
+    result.rate = result.timing.rate();
+
+    return result;
+}
+
+uint32_t get_mode_index(std::span<const display::mode> modes,
+                        const display::mode &target_mode)
+{
+    double rate = wanted_rate(target_mode).value();
+    size_t best = modes.size();
+    double best_distance = INFINITY;
+
+    for (size_t i = 0, size = modes.size(); i < size; i++)
+    {
+        const display::mode &mode = modes[i];
+
+        if (mode.width != target_mode.width ||
+            mode.height != target_mode.height)
+            continue;
+
+        if (!target_mode.timing.empty() && mode.timing == target_mode.timing)
+            return static_cast<uint32_t>(i);
+
+        double distance = std::fabs(mode.rate - rate);
+        if (distance < best_distance)
+        {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    if (best == modes.size())
+        throw std::runtime_error("Target mode not found in mode list.");
+    return static_cast<uint32_t>(best);
+}
+
+RRMode find_mode_id_by_info(const x11::snapshot &snapshot,
+                            const x11::snapshot::output &info,
+                            const display::mode &target_mode)
+{
+    const std::vector<x11::snapshot::mode> &modes = snapshot.modes;
+    display::rational_rate rate = wanted_rate(target_mode);
+
+    auto size_of = [&](uint32_t i)
+    { return std::pair(modes[i].width, modes[i].height); };
+    auto rate_of = [&](uint32_t i) { return modes[i].rate; };
+
+    std::pair size(target_mode.width, target_mode.height);
+    auto [first, last] = std::ranges::equal_range(
+        snapshot.mode_table(info), size, {}, size_of);
+
+    if (first == last)
+        throw std::runtime_error("Mode not found in resources.");
+
+    auto above = std::ranges::lower_bound(first, last, rate, {}, rate_of);
+
+    if (!target_mode.timing.empty())
+    {
+        for (auto it = above; it != last && modes[*it].rate == rate; ++it)
+        {
+            if (modes[*it].timing() == target_mode.timing)
+                return modes[*it].id;
+        }
+    }
+
+    // Nearest rate; among equal rates the lower_bound lands on the one the
+    // output prefers.
+    if (above == last ||
+        (above != first &&
+         nearer_below(rate, modes[*(above - 1)].rate, modes[*above].rate)))
+    {
+        display::rational_rate below = modes[*(above - 1)].rate;
+        above = std::ranges::lower_bound(first, above, below, {}, rate_of);
+    }
+
+    return modes[*above].id;
+}
+
+} // namespace modes
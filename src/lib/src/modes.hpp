@@ -0,0 +1,25 @@
+#pragma once
+
+#include <dman/display.hpp>
+
+#include "x11.hpp"
+
+// Matching requested modes against what an output offers.
+namespace modes
+{
+
+display::mode calc_mode_from_info(const x11::snapshot &snapshot,
+                                  const x11::snapshot::mode &info);
+
+// Index of the first mode in `modes` equal to `target_mode`. Throws if
+// there is none.
+uint32_t get_mode_index(std::span<const display::mode> modes,
+                        const display::mode &target_mode);
+
+// The id of the first of the output's modes equal to `target_mode`. Throws
+// if there is none.
+RRMode find_mode_id_by_info(const x11::snapshot &snapshot,
+                            const x11::snapshot::output &info,
+                            const display::mode &target_mode);
+
+} // namespace modes
@@ -0,0 +1,96 @@
+#include "module.hpp"
+
+#include <dman/exception.hpp>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+static module::options settings;
+
+// Modules are found through the executable's run path, which points at the
+// build tree or the installed module directory, or LD_LIBRARY_PATH. Loaded
+// modules stay loaded for the rest of the process.
+static const module::interface *load(const std::string &name, bool required)
+{
+    static std::unordered_map<std::string, const module::interface *> loaded;
+
+    auto it = loaded.find(name);
+    if (it != loaded.end())
+        return it->second;
+
+    std::string file = "dman-" + name + ".so";
+    const module::interface *result = nullptr;
+
+    if (void *handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL))
+        result = (const module::interface *)dlsym(handle, "dman_module");
+
+    if (!result && required)
+    {
+        const char *error = dlerror();
+        throw common::exception("Failed to load " + file + ": " +
+                                (error ? error : "no dman_module"));
+    }
+
+    loaded.emplace(name, result);
+    return result;
+}
+
+void display::record_session(const std::string &path)
+{
+    std::ofstream truncate(path, std::ios::out | std::ios::trunc);
+    if (!truncate)
+        throw common::exception("Failed to open file: " + path);
+    settings.record_path = path;
+}
+
+void display::replay_session(const std::string &path)
+{
+    settings.replay_path = path;
+}
+
+void display::probe_hardware(bool probe)
+{
+    settings.probe_hardware = probe;
+}
+
+namespace module
+{
+
+std::unique_ptr<connection> connect()
+{
+    // Without the Wayland module installed, RandR under Xwayland still
+    // works for what it can do.
+    if (!settings.capturing() && std::getenv("WAYLAND_DISPLAY"))
+    {
+        if (const interface *wlroots = load("wlroots", false))
+        {
+            if (std::unique_ptr<connection> result =
+                    wlroots->connect(settings))
+                return result;
+        }
+    }
+
+    if (settings.replay_path.empty() && !std::getenv("DISPLAY"))
+        throw std::runtime_error("Failed to open X display.");
+
+    return load("x11", true)->connect(settings);
+}
+
+void watch(const display::layout_selector &select, int settle_ms)
+{
+    if (!settings.capturing() && std::getenv("WAYLAND_DISPLAY"))
+    {
+        if (const interface *wlroots = load("wlroots", false))
+            wlroots->watch(settings, select, settle_ms);
+    }
+
+    if (settings.replay_path.empty() && !std::getenv("DISPLAY"))
+        throw std::runtime_error("Failed to open X display.");
+
+    load("x11", true)->watch(settings, select, settle_ms);
+    throw std::runtime_error("Stopped watching for display changes.");
+}
+
+} // namespace module
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <dman/display.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Backends are modules loaded the first time a display server is needed,
+// so a run only maps the libraries of the server it talks to, and one that
+// talks to none maps none of them. Modules call back into the executable
+// for everything else.
+namespace module
+{
+
+// What display::record_session, replay_session and probe_hardware set.
+struct options
+{
+    std::string record_path;
+    std::string replay_path;
+    bool probe_hardware = false;
+
+    // Captures only cover RandR.
+    bool capturing() const
+    {
+        return !record_path.empty() || !replay_path.empty();
+    }
+};
+
+// One connection to a display server, as display::context uses it.
+class connection
+{
+  public:
+    virtual ~connection() {};
+
+    // Appends to `result`, allocating from its resource.
+    virtual void outputs(std::pmr::vector<display::output> &result) = 0;
+    // Describes the requests apply would send, one per line.
+    virtual std::string plan(const digest::map<display::state> &outputs) = 0;
+    virtual void apply(const digest::map<display::state> &outputs) = 0;
+};
+
+// Exported by every module as `dman_module`.
+struct interface
+{
+    // Returns nothing when the server isn't there or lacks what's needed.
+    std::unique_ptr<connection> (*connect)(const options &options);
+    // Returns at once when the server isn't there or lacks what's needed;
+    // otherwise only returns by throwing.
+    void (*watch)(const options &options,
+                  const display::layout_selector &select,
+                  int settle_ms);
+};
+
+// Wayland when a wlroots compositor offers output management, RandR
+// otherwise.
+std::unique_ptr<connection> connect();
+
+// Watches whichever server connect would pick.
+
+[[noreturn]] void watch(const display::layout_selector &select,
+                        int settle_ms);
+
+} // namespace module
+
+extern "C" const module::interface dman_module;
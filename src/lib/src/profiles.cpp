@@ -0,0 +1,272 @@
+#include <dman/config.hpp>
+#include <dman/digest.hpp>
+#include <dman/display.hpp>
+#include <dman/exception.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk layout: a header, an open-addressed hash table of slots keyed by
+// profile key, then the text of every profile in the usual config format.
+
+namespace
+{
+
+constexpr char profiles_magic[8] = {'D', 'M', 'A', 'N', 'P', 'R', 'F', '2'};
+constexpr size_t key_size = 32;
+
+// Exhaustively trying every subset is only reasonable for small sets.
+constexpr size_t max_subset_search = 12;
+
+struct header
+{
+    char magic[8];
+    uint32_t slot_count;
+    uint32_t profile_count;
+};
+
+struct slot
+{
+    uint8_t key[key_size];
+    uint32_t offset;
+    uint32_t length;
+};
+
+} // namespace
+
+static size_t slot_index(const std::string &key, uint32_t slot_count)
+{
+    uint64_t prefix;
+    std::memcpy(&prefix, key.data(), sizeof(prefix));
+    return prefix & (slot_count - 1);
+}
+
+namespace util::display
+{
+
+profiles::profiles(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw common::not_found(path);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(header))
+    {
+        close(fd);
+        throw common::exception("Invalid profile store: " + path);
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        throw common::exception("Failed to map profile store: " + path);
+
+    mapped = (const uint8_t *)map;
+    mapped_size = st.st_size;
+
+    header head;
+    std::memcpy(&head, mapped, sizeof(head));
+
+    if (std::memcmp(head.magic, profiles_magic, sizeof(profiles_magic)) != 0 ||
+        !std::has_single_bit(head.slot_count) ||
+        sizeof(header) + (size_t)head.slot_count * sizeof(slot) > mapped_size)
+    {
+        munmap(map, mapped_size);
+        mapped = nullptr;
+        throw common::exception("Invalid profile store: " + path);
+    }
+}
+
+profiles::~profiles()
+{
+    if (mapped)
+        munmap((void *)mapped, mapped_size);
+}
+
+std::string profiles::key(std::vector<digest::sha256> edids)
+{
+    std::sort(edids.begin(), edids.end());
+
+    std::string joined;
+    for (const digest::sha256 &edid : edids)
+        joined.append((const char *)edid.data(), key_size);
+
+    digest::sha256 digest(joined);
+    return std::string((const char *)digest.data(), key_size);
+}
+
+const std::string *profiles::find_added(const std::string &key) const
+{
+    auto it = added.find(key);
+    if (it == added.end())
+        return nullptr;
+    return &it->second;
+}
+
+std::optional<std::string> profiles::find_mapped(const std::string &key) const
+{
+    if (!mapped)
+        return std::nullopt;
+
+    header head;
+    std::memcpy(&head, mapped, sizeof(head));
+
+    const uint8_t *slots = mapped + sizeof(header);
+
+    for (size_t i = slot_index(key, head.slot_count), probes = 0;
+         probes < head.slot_count;
+         i = (i + 1) & (head.slot_count - 1), ++probes)
+    {
+        slot entry;
+        std::memcpy(&entry, slots + i * sizeof(slot), sizeof(entry));
+
+        if (entry.length == 0)
+            return std::nullopt;
+
+        if (std::memcmp(entry.key, key.data(), key_size) != 0)
+            continue;
+
+        if ((size_t)entry.offset + entry.length > mapped_size)
+            throw common::exception("Corrupt profile store.");
+
+        return std::string((const char *)mapped + entry.offset, entry.length);
+    }
+
+    return std::nullopt;
+}
+
+std::optional<std::string> profiles::find(const std::string &key) const
+{
+    if (const std::string *text = find_added(key))
+        return *text;
+    return find_mapped(key);
+}
+
+void profiles::add(const config &profile)
+{
+    std::vector<digest::sha256> edids;
+    for (const auto &[edid, state] : profile.outputs)
+        edids.push_back(edid);
+
+    // An empty length marks a free slot in a saved store, so an empty
+    // profile could never be read back.
+    std::string text = (std::string)profile;
+    if (text.empty())
+        throw common::exception("Cannot add a profile with no outputs.");
+
+    added[key(edids)] = std::move(text);
+}
+
+void profiles::save(const std::string &path) const
+{
+    std::unordered_map<std::string, std::string> all = added;
+
+    if (mapped)
+    {
+        header head;
+        std::memcpy(&head, mapped, sizeof(head));
+
+        for (uint32_t i = 0; i < head.slot_count; ++i)
+        {
+            slot entry;
+            std::memcpy(&entry,
+                        mapped + sizeof(header) + i * sizeof(slot),
+                        sizeof(entry));
+
+            if (entry.length == 0)
+                continue;
+
+            std::string key((const char *)entry.key, key_size);
+            if (all.find(key) == all.end())
+                all[key] = *find_mapped(key);
+        }
+    }
+
+    header head = {};
+    std::memcpy(head.magic, profiles_magic, sizeof(profiles_magic));
+    head.slot_count = std::bit_ceil(all.size() * 2 + 1);
+    head.profile_count = all.size();
+
+    std::vector<slot> slots(head.slot_count);
+    std::string texts;
+    size_t texts_offset = sizeof(header) + slots.size() * sizeof(slot);
+
+    for (const auto &[key, text] : all)
+    {
+        size_t i = slot_index(key, head.slot_count);
+        while (slots[i].length != 0)
+            i = (i + 1) & (head.slot_count - 1);
+
+        std::memcpy(slots[i].key, key.data(), key_size);
+        slots[i].offset = texts_offset + texts.size();
+        slots[i].length = text.size();
+        texts += text;
+    }
+
+    // Write beside the destination and rename over it, since the old file
+    // may still be mapped by this or another process.
+    std::string temporary = path + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+        throw common::exception("Failed to open file: " + temporary);
+
+    bool ok = std::fwrite(&head, sizeof(head), 1, file) == 1 &&
+              std::fwrite(slots.data(), sizeof(slot), slots.size(), file) ==
+                  slots.size() &&
+              std::fwrite(texts.data(), 1, texts.size(), file) == texts.size();
+
+    if (std::fclose(file) != 0 || !ok ||
+        std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw common::exception("Failed to write profile store: " + path);
+    }
+}
+
+std::optional<config>
+profiles::match(const std::vector<digest::sha256> &edids) const
+{
+    if (std::optional<std::string> text = find(key(edids)))
+        return config(*text);
+
+    size_t count = edids.size();
+    if (count == 0 || count > max_subset_search)
+        return std::nullopt;
+
+    std::optional<std::string> best;
+    int best_size = 0;
+
+    for (uint32_t mask = (1u << count) - 2; mask > 0; --mask)
+    {
+        int size = std::popcount(mask);
+        if (size <= best_size)
+            continue;
+
+        std::vector<digest::sha256> subset;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (mask & (1u << i))
+                subset.push_back(edids[i]);
+        }
+
+        if (std::optional<std::string> text = find(key(subset)))
+        {
+            best = std::move(text);
+            best_size = size;
+        }
+    }
+
+    if (!best)
+        return std::nullopt;
+
+    return config(*best);
+}
+
+} // namespace util::display
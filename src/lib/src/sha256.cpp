@@ -0,0 +1,263 @@
+#include "sha256.hpp"
+
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+constexpr size_t block_size = 64;
+
+using compress_function = void (*)(uint32_t state[8],
+                                   const uint8_t *data,
+                                   size_t blocks);
+
+struct dispatch
+{
+    compress_function compress;
+    const char *name;
+};
+
+} // namespace
+
+alignas(16) static const uint32_t round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t initial_state[8] = {
+    0x6a09e667,
+    0xbb67ae85,
+    0x3c6ef372,
+    0xa54ff53a,
+    0x510e527f,
+    0x9b05688c,
+    0x1f83d9ab,
+    0x5be0cd19,
+};
+
+static uint32_t rotate_right(uint32_t value, int count)
+{
+    return (value >> count) | (value << (32 - count));
+}
+
+static uint32_t load_big_endian(const uint8_t *data)
+{
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+           (uint32_t)data[2] << 8 | (uint32_t)data[3];
+}
+
+static void store_big_endian(uint8_t *out, uint64_t value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; --i, value >>= 8)
+        out[i] = (uint8_t)value;
+}
+
+static void
+compress_portable(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    for (; blocks > 0; --blocks, data += block_size)
+    {
+        uint32_t w[64];
+
+        for (int i = 0; i < 16; ++i)
+            w[i] = load_big_endian(data + 4 * i);
+
+        for (int i = 16; i < 64; ++i)
+        {
+            uint32_t s0 = rotate_right(w[i - 15], 7) ^
+                          rotate_right(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotate_right(w[i - 2], 17) ^
+                          rotate_right(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int i = 0; i < 64; ++i)
+        {
+            uint32_t s1 =
+                rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+            uint32_t choose = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + choose + round_constants[i] + w[i];
+            uint32_t s0 =
+                rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+            uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + majority;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if defined(__x86_64__)
+
+// The SHA extensions keep the state as ABEF and CDGH halves and do two
+// rounds per instruction, four message words at a time.
+__attribute__((target("sha,ssse3,sse4.1"))) static void
+compress_sha_ni(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    const __m128i byte_swap =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i dcba = _mm_loadu_si128((const __m128i *)&state[0]);
+    __m128i hgfe = _mm_loadu_si128((const __m128i *)&state[4]);
+
+    __m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for (; blocks > 0; --blocks, data += block_size)
+    {
+        __m128i abef_saved = abef;
+        __m128i cdgh_saved = cdgh;
+        __m128i w[16];
+
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; ++i)
+        {
+            if (i < 4)
+                w[i] = _mm_shuffle_epi8(
+                    _mm_loadu_si128((const __m128i *)(data + 16 * i)),
+                    byte_swap);
+            else
+                w[i] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(_mm_sha256msg1_epu32(w[i - 4], w[i - 3]),
+                                  _mm_alignr_epi8(w[i - 1], w[i - 2], 4)),
+                    w[i - 1]);
+
+            __m128i words = _mm_add_epi32(
+                w[i], _mm_load_si128((const __m128i *)&round_constants[4 * i]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+            abef = _mm_sha256rnds2_epu32(
+                abef, cdgh, _mm_shuffle_epi32(words, 0x0E));
+        }
+
+        abef = _mm_add_epi32(abef, abef_saved);
+        cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    dcba = _mm_blend_epi16(feba, dchg, 0xF0);
+    hgfe = _mm_alignr_epi8(dchg, feba, 8);
+
+    _mm_storeu_si128((__m128i *)&state[0], dcba);
+    _mm_storeu_si128((__m128i *)&state[4], hgfe);
+}
+
+static bool has_sha_ni()
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) ||
+        !(ecx & bit_SSSE3))
+        return false;
+
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+}
+
+#endif
+
+static const dispatch portable = {compress_portable, "portable"};
+
+static dispatch &select()
+{
+    static dispatch chosen = [] {
+#if defined(__x86_64__)
+        if (has_sha_ni())
+            return dispatch{compress_sha_ni, "sha-ni"};
+#endif
+        return portable;
+    }();
+    return chosen;
+}
+
+namespace sha2
+{
+
+void hash256(const void *data, size_t size, uint8_t out[32])
+{
+    compress_function compress = select().compress;
+
+    uint32_t state[8];
+    std::memcpy(state, initial_state, sizeof(state));
+
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t full_blocks = size / block_size;
+    compress(state, bytes, full_blocks);
+
+    // The rest of the input, a one bit, zeros and the length in bits fill
+    // one or two more blocks.
+    uint8_t tail[2 * block_size] = {};
+    size_t rest = size % block_size;
+    std::memcpy(tail, bytes + full_blocks * block_size, rest);
+    tail[rest] = 0x80;
+
+    size_t tail_blocks = rest + 1 + 8 > block_size ? 2 : 1;
+    store_big_endian(tail + tail_blocks * block_size - 8, (uint64_t)size * 8, 8);
+    compress(state, tail, tail_blocks);
+
+    for (int i = 0; i < 8; ++i)
+        store_big_endian(out + 4 * i, state[i], 4);
+}
+
+const char *implementation()
+{
+    return select().name;
+}
+
+bool use_implementation(const char *name)
+{
+    std::string_view wanted = name;
+
+    if (wanted == portable.name)
+    {
+        select() = portable;
+        return true;
+    }
+
+#if defined(__x86_64__)
+    if (wanted == "sha-ni" && has_sha_ni())
+    {
+        select() = dispatch{compress_sha_ni, "sha-ni"};
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+} // namespace sha2
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// SHA-256 without a crypto library, so starting dman doesn't load and
+// relocate one. Uses the SHA extensions on x86-64 CPUs that have them.
+namespace sha2
+{
+
+void hash256(const void *data, size_t size, uint8_t out[32]);
+
+// The compression function in use, for benchmarks: "sha-ni" or "portable".
+const char *implementation();
+
+// Switches to the named compression function, for tests that check both.
+// Returns false, changing nothing, when this CPU can't run it.
+bool use_implementation(const char *name);
+
+} // namespace sha2
@@ -0,0 +1,83 @@
+#include <dman/stats.hpp>
+
+#include <sstream>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+stats::counters totals[(int)stats::phase::COUNT];
+stats::phase current = stats::phase::OTHER;
+clock_type::time_point since = clock_type::now();
+
+const char *const phase_names[(int)stats::phase::COUNT] = {
+    "other", "connect", "probe", "edid", "parse", "plan", "apply"};
+
+} // namespace
+
+// Charges the time since the last phase change to the current phase and
+// switches to `next`.
+static void switch_phase(stats::phase next)
+{
+    clock_type::time_point now = clock_type::now();
+    totals[(int)current].time += now - since;
+    since = now;
+    current = next;
+}
+
+namespace stats
+{
+
+const counters &get(phase phase)
+{
+    return totals[(int)phase];
+}
+
+void record(uint64_t requests, uint64_t round_trips, uint64_t bytes)
+{
+    record(current, requests, round_trips, bytes);
+}
+
+void record(phase phase,
+            uint64_t requests,
+            uint64_t round_trips,
+            uint64_t bytes)
+{
+    counters &total = totals[(int)phase];
+    total.requests += requests;
+    total.round_trips += round_trips;
+    total.bytes += bytes;
+}
+
+scope::scope(phase phase) : previous(current)
+{
+    switch_phase(phase);
+}
+
+scope::~scope()
+{
+    switch_phase(previous);
+}
+
+std::string json()
+{
+    switch_phase(current);
+
+    std::ostringstream oss;
+    oss << "{";
+    for (int i = 0; i < (int)phase::COUNT; ++i)
+    {
+        const counters &total = totals[i];
+        oss << (i ? "," : "") << "\"" << phase_names[i] << "\":{"
+            << "\"requests\":" << total.requests
+            << ",\"round_trips\":" << total.round_trips
+            << ",\"bytes\":" << total.bytes << ",\"ms\":"
+            << std::chrono::duration<double, std::milli>(total.time).count()
+            << "}";
+    }
+    oss << "}";
+    return oss.str();
+}
+
+} // namespace stats
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "x11.hpp"
+
+#include <X11/extensions/XInput.h>
+#include <X11/extensions/XInput2.h>
+#include <string>
+
+// Pointing a tablet at one output through XInput. Kept apart from the RandR
+// backend so that only what uses it links libXi.
+namespace x11
+{
+
+class device_info
+{
+    XDeviceInfo *contents;
+    int ndevices;
+
+  public:
+    explicit device_info(session &sess);
+    ~device_info();
+
+    XDeviceInfo *operator[](const std::string &name) const;
+};
+
+class xi_device_info
+{
+    XIDeviceInfo *contents;
+
+  public:
+    xi_device_info(session &sess, XID device_id);
+    ~xi_device_info();
+
+    XIDeviceInfo *operator[](const std::string &name) const;
+    XIDeviceInfo *operator->() const;
+
+    display::vec2<uint32_t> get_tablet_dimensions() const;
+    std::string get_name() const;
+};
+
+class x_device
+{
+    XDevice *contents;
+    Display *display;
+
+  public:
+    x_device(session &sess, XDeviceInfo *device_info);
+    ~x_device();
+
+    XDevice *operator->() const;
+
+    bool set_coodinate_transformation_matrix(const float matrix[3][3]);
+};
+
+// Maps the named tablet onto the output with this name or EDID digest.
+// Returns false when either can't be found.
+bool map_tablet_to_output(const std::string &tablet_name,
+                          const std::string &output_name);
+
+} // namespace x11
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "module.hpp"
+
+#include <dman/display.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <wayland-client.h>
+#include "wlr-output-management-unstable-v1-client-protocol.h"
+}
+
+// A client of the wlr-output-management protocol, for compositors such as
+// sway and labwc that don't let clients configure outputs through RandR.
+namespace wlroots
+{
+
+struct head;
+
+struct mode
+{
+    zwlr_output_mode_v1 *handle;
+    struct head *head;
+    int32_t width = 0;
+    int32_t height = 0;
+    // In mHz, or 0 when the compositor doesn't know it.
+    int32_t refresh = 0;
+    bool preferred = false;
+};
+
+struct head
+{
+    zwlr_output_head_v1 *handle;
+    class session *sess;
+    std::string name;
+    std::string make;
+    std::string model;
+    std::string serial_number;
+    bool enabled = false;
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t transform = WL_OUTPUT_TRANSFORM_NORMAL;
+    // In the order the compositor listed them, preferred first.
+    std::vector<std::unique_ptr<mode>> modes;
+    const mode *current_mode = nullptr;
+};
+
+// The compositor's output state, kept current by its events.
+class session : public module::connection
+{
+    wl_display *display;
+    wl_registry *registry;
+
+    void dispatch();
+
+  public:
+    zwlr_output_manager_v1 *manager = nullptr;
+    uint32_t version = 0;
+    uint32_t serial = 0;
+    bool done = false;
+    std::vector<std::unique_ptr<head>> heads;
+
+    // Returns nothing when there's no Wayland compositor to talk to, or it
+    // doesn't offer output management.
+    static std::unique_ptr<session> connect();
+
+    explicit session(wl_display *display);
+    ~session() override;
+
+    session(const session &) = delete;
+    session &operator=(const session &) = delete;
+
+    void outputs(std::pmr::vector<display::output> &result) override;
+
+    // Describes the heads apply would change, one per line.
+    std::string plan(const digest::map<display::state> &outputs) override;
+
+    // Has the compositor test the whole layout, then applies it as one
+    // configuration. Throws if the layout is rejected.
+    void apply(const digest::map<display::state> &outputs) override;
+
+    // The sorted digests of every head's display.
+    std::vector<digest::sha256> connected_edids() const;
+
+    // Blocks until the compositor sends a change, then keeps taking events
+    // until none arrive for `settle_ms`.
+    void wait(int settle_ms);
+};
+
+} // namespace wlroots
@@ -0,0 +1,149 @@
+#include "x11.hpp"
+
+#include <algorithm>
+
+static constexpr size_t unmatched = SIZE_MAX;
+
+namespace
+{
+
+// Outputs on one side and the snapshot's CRTCs on the other, with an edge
+// wherever the server lists the CRTC as one that can drive the output.
+struct matching
+{
+    // Of each output, the CRTCs it can use, most preferred first.
+    std::vector<std::vector<size_t>> candidates;
+    std::vector<size_t> crtc_of;
+    std::vector<size_t> output_of;
+    std::vector<bool> visited;
+};
+
+} // namespace
+
+// Its own CRTC first, then idle ones, then ones that drive something else
+// now.
+static std::vector<size_t> find_candidates(const x11::snapshot &snapshot,
+                                           const x11::snapshot::output &info)
+{
+    std::vector<size_t> result;
+    for (size_t i = 0; i < snapshot.crtcs.size(); ++i)
+    {
+        const x11::snapshot::crtc &crtc = snapshot.crtcs[i];
+        if (std::find(info.crtcs.begin(), info.crtcs.end(), crtc.id) !=
+            info.crtcs.end())
+            result.push_back(i);
+    }
+
+    auto rank = [&](size_t i) {
+        const x11::snapshot::crtc &crtc = snapshot.crtcs[i];
+        return crtc.id == info.crtc ? 0 : crtc.mode == None ? 1 : 2;
+    };
+    std::stable_sort(result.begin(), result.end(), [&](size_t a, size_t b) {
+        return rank(a) < rank(b);
+    });
+    return result;
+}
+
+// Finds the output a CRTC it can use, moving the outputs in its way to
+// other CRTCs of theirs where that makes room. A free CRTC is taken before
+// any output is moved, so clones sharing a CRTC don't push each other off
+// it while another sits idle.
+static bool augment(matching &graph, size_t output)
+{
+    for (size_t crtc : graph.candidates[output])
+    {
+        if (!graph.visited[crtc] && graph.output_of[crtc] == unmatched)
+        {
+            graph.visited[crtc] = true;
+            graph.output_of[crtc] = output;
+            graph.crtc_of[output] = crtc;
+            return true;
+        }
+    }
+
+    for (size_t crtc : graph.candidates[output])
+    {
+        if (graph.visited[crtc])
+            continue;
+        graph.visited[crtc] = true;
+
+        if (graph.output_of[crtc] == unmatched ||
+            augment(graph, graph.output_of[crtc]))
+        {
+            graph.output_of[crtc] = output;
+            graph.crtc_of[output] = crtc;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace x11
+{
+
+std::vector<RRCrtc> assign_crtcs(const snapshot &snapshot,
+                                 const std::vector<RROutput> &outputs)
+{
+    matching graph;
+    graph.candidates.resize(outputs.size());
+    graph.crtc_of.assign(outputs.size(), unmatched);
+    graph.output_of.assign(snapshot.crtcs.size(), unmatched);
+
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        const snapshot::output *info = snapshot.find_output(outputs[i]);
+        if (info)
+            graph.candidates[i] = find_candidates(snapshot, *info);
+    }
+
+    // Outputs start on the CRTC they already have, so a matching only moves
+    // them when another output can't be driven otherwise.
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        const snapshot::output *info = snapshot.find_output(outputs[i]);
+        if (!info || graph.candidates[i].empty())
+            continue;
+
+        size_t crtc = graph.candidates[i].front();
+        if (snapshot.crtcs[crtc].id == info->crtc &&
+            graph.output_of[crtc] == unmatched)
+        {
+            graph.output_of[crtc] = i;
+            graph.crtc_of[i] = crtc;
+        }
+    }
+
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        if (graph.crtc_of[i] != unmatched)
+            continue;
+        graph.visited.assign(snapshot.crtcs.size(), false);
+        augment(graph, i);
+    }
+
+    std::vector<RRCrtc> result(outputs.size(), None);
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        if (graph.crtc_of[i] != unmatched)
+            result[i] = snapshot.crtcs[graph.crtc_of[i]].id;
+    }
+    return result;
+}
+
+void disable_unused_crtcs(const snapshot &snapshot, layout &layout)
+{
+    for (const snapshot::crtc &crtc : snapshot.crtcs)
+    {
+        if (crtc.mode == None)
+            continue;
+
+        bool used = false;
+        for (const crtc_config &config : layout.crtcs)
+            used = used || config.crtc == crtc.id;
+
+        if (!used)
+            layout.crtcs.push_back(crtc_config{.crtc = crtc.id});
+    }
+}
+
+} // namespace x11
@@ -0,0 +1,313 @@
+#include "x11.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+// Plans are line based: a `plan KEY` line, the layout's lines and an `end`
+// line. The most recent few are kept, newest last.
+
+static constexpr size_t max_plans = 16;
+
+template <typename T> static void append_bytes(std::string &out, T value)
+{
+    out.append((const char *)&value, sizeof(value));
+}
+
+static std::string cache_dir()
+{
+    if (const char *cache = std::getenv("XDG_CACHE_HOME"); cache && *cache)
+        return std::string(cache) + "/dman";
+    if (const char *home = std::getenv("HOME"); home && *home)
+        return std::string(home) + "/.cache/dman";
+    return {};
+}
+
+static void write_layout(std::ostream &out, const x11::layout &layout)
+{
+    for (const x11::crtc_config &config : layout.crtcs)
+    {
+        // Disabled CRTCs depend on what's running; load adds them back.
+        if (config.mode == None)
+            continue;
+
+        out << "crtc " << config.crtc << " " << config.x << " " << config.y
+            << " " << config.mode << " " << config.rotation << " "
+            << config.width << " " << config.height << " "
+            << config.outputs.size();
+        for (RROutput output : config.outputs)
+            out << " " << output;
+        out << "\n";
+    }
+
+    out << "screen " << layout.screen_size.x << " " << layout.screen_size.y
+        << " " << layout.screen_size_mm.x << " " << layout.screen_size_mm.y
+        << "\n";
+    out << "primary " << layout.primary << "\n";
+
+    for (const auto &[output, value] : layout.tearfree)
+        out << "tearfree " << output << " " << (int)value << "\n";
+}
+
+// Reads layout lines up to and including `end`, or nothing if they don't
+// parse or name more outputs than `snapshot` has.
+static std::optional<x11::layout> read_layout(std::istream &in,
+                                              const x11::snapshot &snapshot)
+{
+    x11::layout layout;
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+
+        if (kind == "end")
+            return layout;
+
+        if (kind == "crtc")
+        {
+            x11::crtc_config config;
+            size_t count = 0;
+            fields >> config.crtc >> config.x >> config.y >> config.mode >>
+                config.rotation >> config.width >> config.height >> count;
+            if (!fields || count > snapshot.outputs.size())
+                return std::nullopt;
+            config.outputs.resize(count);
+            for (RROutput &output : config.outputs)
+                fields >> output;
+            layout.crtcs.push_back(std::move(config));
+        }
+        else if (kind == "screen")
+        {
+            fields >> layout.screen_size.x >> layout.screen_size.y >>
+                layout.screen_size_mm.x >> layout.screen_size_mm.y;
+        }
+        else if (kind == "primary")
+        {
+            fields >> layout.primary;
+        }
+        else if (kind == "tearfree")
+        {
+            RROutput output = None;
+            int value = 0;
+            fields >> output >> value;
+            layout.tearfree.emplace_back(output, (display::tearfree)value);
+        }
+        else
+        {
+            return std::nullopt;
+        }
+
+        if (!fields)
+            return std::nullopt;
+    }
+
+    return std::nullopt;
+}
+
+// Whether `layout` can still be applied over `snapshot`: everything it names
+// exists and each output can be driven by the CRTC it was given.
+static bool still_applies(const x11::layout &layout,
+                          const x11::snapshot &snapshot)
+{
+    for (const x11::crtc_config &config : layout.crtcs)
+    {
+        if (!snapshot.find_crtc(config.crtc) ||
+            !snapshot.find_mode(config.mode))
+            return false;
+
+        for (RROutput output_id : config.outputs)
+        {
+            const x11::snapshot::output *output =
+                snapshot.find_output(output_id);
+            if (!output || output->connection != RR_Connected ||
+                std::find(output->crtcs.begin(),
+                          output->crtcs.end(),
+                          config.crtc) == output->crtcs.end())
+                return false;
+        }
+    }
+
+    if (layout.primary != None && !snapshot.find_output(layout.primary))
+        return false;
+
+    for (const auto &[output, value] : layout.tearfree)
+    {
+        if (!snapshot.find_output(output))
+            return false;
+    }
+
+    return true;
+}
+
+namespace x11
+{
+
+plan_cache::plan_cache(const module::options &options)
+{
+    // Captured timings would depend on what earlier runs left in the
+    // user's cache.
+    if (options.capturing())
+        return;
+
+    std::string dir = cache_dir();
+    if (!dir.empty())
+        path = dir + "/plans";
+}
+
+digest::sha256
+plan_cache::key(const digest::map<display::state> &outputs,
+                const snapshot &snapshot)
+{
+    std::vector<const std::pair<const digest::sha256, display::state> *>
+        sorted;
+    for (const auto &entry : outputs)
+        sorted.push_back(&entry);
+    std::sort(sorted.begin(), sorted.end(), [](auto *a, auto *b) {
+        return a->first < b->first;
+    });
+
+    std::string input;
+
+    for (const auto *entry : sorted)
+    {
+        const display::state &state = entry->second;
+        input.append((const char *)entry->first.data(), 32);
+        append_bytes(input, state.mode.width);
+        append_bytes(input, state.mode.height);
+        append_bytes(input, state.mode.rate);
+        append_bytes(input, state.mode.timing.dot_clock);
+        append_bytes(input, state.mode.timing.h_total);
+        append_bytes(input, state.mode.timing.v_total);
+        append_bytes(input, state.mode.timing.flags);
+        append_bytes(input, state.position.x);
+        append_bytes(input, state.position.y);
+        append_bytes(input, state.rotation);
+        append_bytes(input, state.is_primary);
+        append_bytes(input, state.is_active);
+        append_bytes(input, state.is_tearfree);
+    }
+
+    // Which connector each display is on matters as much as which are
+    // connected: the plan names outputs, not displays.
+    append_bytes(input, snapshot.config_timestamp);
+    for (const snapshot::output &output : snapshot.outputs)
+    {
+        if (output.connection != RR_Connected)
+            continue;
+        append_bytes(input, output.id);
+        append_bytes(input, output.edid.size());
+        input.append((const char *)output.edid.data(), output.edid.size());
+    }
+
+    // So does which CRTC drives which output: a plan made under another
+    // arrangement would move outputs between CRTCs for nothing.
+    for (const snapshot::crtc &crtc : snapshot.crtcs)
+    {
+        append_bytes(input, crtc.id);
+        append_bytes(input, crtc.outputs.size());
+        for (RROutput output : crtc.outputs)
+            append_bytes(input, output);
+    }
+
+    return digest::sha256(input.data(), input.size());
+}
+
+std::optional<layout> plan_cache::load(const digest::sha256 &key,
+                                       const snapshot &snapshot) const
+{
+    if (path.empty())
+        return std::nullopt;
+
+    // The file is only a cache; whatever goes wrong reading it is a miss.
+    try
+    {
+        std::ifstream in(path);
+        std::string wanted = "plan " + key.hex();
+        std::string line;
+
+        while (std::getline(in, line))
+        {
+            if (line != wanted)
+                continue;
+
+            std::optional<layout> result = read_layout(in, snapshot);
+            if (!result || !still_applies(*result, snapshot))
+                return std::nullopt;
+
+            disable_unused_crtcs(snapshot, *result);
+            return result;
+        }
+    }
+    catch (const std::exception &)
+    {
+    }
+
+    return std::nullopt;
+}
+
+void plan_cache::store(const digest::sha256 &key, const layout &layout) const
+{
+    if (path.empty())
+        return;
+
+    std::string header = "plan " + key.hex();
+
+    // Keeps the other plans, one string each, dropping any older copy of
+    // this one.
+    std::vector<std::string> plans;
+    {
+        std::ifstream in(path);
+        std::string line;
+        bool keep = false;
+
+        while (std::getline(in, line))
+        {
+            if (line.starts_with("plan "))
+            {
+                keep = line != header;
+                if (keep)
+                    plans.emplace_back();
+            }
+            if (keep)
+                plans.back() += line + "\n";
+        }
+    }
+
+    std::ostringstream entry;
+    entry << header << "\n";
+    write_layout(entry, layout);
+    entry << "end\n";
+    plans.push_back(entry.str());
+
+    if (plans.size() > max_plans)
+        plans.erase(plans.begin(), plans.end() - max_plans);
+
+    // A cache that can't be written is only slower, so failures are
+    // ignored. Renaming keeps concurrent runs from reading half a file.
+    std::error_code error;
+    std::filesystem::create_directories(
+        std::filesystem::path(path).parent_path(), error);
+
+    std::string temporary = path + "." + std::to_string(getpid());
+    {
+        std::ofstream out(temporary, std::ios::out | std::ios::trunc);
+        for (const std::string &plan : plans)
+            out << plan;
+        if (!out)
+        {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+        std::filesystem::remove(temporary, error);
+}
+
+} // namespace x11
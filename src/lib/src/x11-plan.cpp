@@ -0,0 +1,159 @@
+#include "x11.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+static bool same_outputs(std::vector<RROutput> a, std::vector<RROutput> b)
+{
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    return a == b;
+}
+
+static bool is_unchanged(const x11::snapshot &before,
+                         const x11::crtc_config &want)
+{
+    const x11::snapshot::crtc *have = before.find_crtc(want.crtc);
+
+    if (!have)
+        return false;
+
+    if (want.mode == None)
+        return have->mode == None;
+
+    return have->mode == want.mode && have->x == want.x &&
+           have->y == want.y && have->rotation == want.rotation &&
+           same_outputs(have->outputs, want.outputs);
+}
+
+static const x11::snapshot::output *find_output(const x11::snapshot &before,
+                                                RROutput output_id)
+{
+    for (const x11::snapshot::output &output : before.outputs)
+    {
+        if (output.id == output_id)
+            return &output;
+    }
+    return nullptr;
+}
+
+static std::string output_name(const x11::snapshot &before, RROutput output_id)
+{
+    const x11::snapshot::output *output = find_output(before, output_id);
+    if (output)
+        return output->name;
+    std::ostringstream oss;
+    oss << "0x" << std::hex << output_id;
+    return oss.str();
+}
+
+static const char *rotation_name(Rotation rotation)
+{
+    switch (rotation)
+    {
+    case RR_Rotate_0:
+        return "normal";
+    case RR_Rotate_90:
+        return "right";
+    case RR_Rotate_180:
+        return "inverted";
+    case RR_Rotate_270:
+        return "left";
+    default:
+        return "unknown";
+    }
+}
+
+static const char *tearfree_name(display::tearfree value)
+{
+    switch (value)
+    {
+    case display::tearfree::ON:
+        return "on";
+    case display::tearfree::AUTO:
+        return "auto";
+    case display::tearfree::OFF:
+        return "off";
+    default:
+        return "unset";
+    }
+}
+
+namespace x11
+{
+
+layout diff(const snapshot &before, const layout &target)
+{
+    layout result;
+
+    for (const crtc_config &want : target.crtcs)
+    {
+        if (!is_unchanged(before, want))
+            result.crtcs.push_back(want);
+    }
+
+    if (target.screen_size.x != before.screen_size.x ||
+        target.screen_size.y != before.screen_size.y)
+    {
+        result.screen_size = target.screen_size;
+        result.screen_size_mm = target.screen_size_mm;
+    }
+
+    if (target.primary != before.primary)
+        result.primary = target.primary;
+
+    for (const auto &[output_id, value] : target.tearfree)
+    {
+        const snapshot::output *output = find_output(before, output_id);
+        if (!output || output->tearfree != value)
+            result.tearfree.emplace_back(output_id, value);
+    }
+
+    return result;
+}
+
+bool layout::empty() const
+{
+    return crtcs.empty() && (screen_size.x == 0 || screen_size.y == 0) &&
+           primary == None && tearfree.empty();
+}
+
+std::string layout::describe(const snapshot &before) const
+{
+    std::ostringstream oss;
+
+    for (const crtc_config &config : crtcs)
+    {
+        oss << "crtc 0x" << std::hex << config.crtc << std::dec;
+
+        if (config.mode == None)
+        {
+            oss << " disable\n";
+            continue;
+        }
+
+        const snapshot::mode *mode = before.find_mode(config.mode);
+        oss << " mode=" << (mode ? before.name(*mode) : "?");
+        oss << " x=" << config.x << " y=" << config.y;
+        oss << " rotation=" << rotation_name(config.rotation);
+        oss << " outputs=";
+        for (size_t i = 0; i < config.outputs.size(); ++i)
+            oss << (i ? "," : "") << output_name(before, config.outputs[i]);
+        oss << "\n";
+    }
+
+    if (screen_size.x > 0 && screen_size.y > 0)
+        oss << "screen width=" << screen_size.x << " height=" << screen_size.y
+            << "\n";
+
+    if (primary != None)
+        oss << "primary " << output_name(before, primary) << "\n";
+
+    for (const auto &[output_id, value] : tearfree)
+        oss << "tearfree " << output_name(before, output_id) << " "
+            << tearfree_name(value) << "\n";
+
+    return oss.str();
+}
+
+} // namespace x11
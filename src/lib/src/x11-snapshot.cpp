@@ -0,0 +1,590 @@
+#include "x11.hpp"
+#include "edid.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace
+{
+
+// The parts of a screen resources reply the snapshot keeps, read from
+// either the probing or the current variant of the request.
+struct resources_lists
+{
+    xcb_timestamp_t timestamp;
+    xcb_timestamp_t config_timestamp;
+    std::vector<x11::snapshot::mode> modes;
+    std::string mode_names;
+    std::vector<RROutput> outputs;
+    std::vector<RRCrtc> crtcs;
+};
+
+struct output_cookies
+{
+    xcb_randr_get_output_info_cookie_t info;
+    xcb_randr_get_output_property_cookie_t edid;
+    xcb_randr_get_output_property_cookie_t tearfree;
+};
+
+} // namespace
+
+static xcb_intern_atom_cookie_t
+intern_atom(xcb_connection_t *connection, const char *name, bool only_if_exists)
+{
+    return xcb_intern_atom(
+        connection, only_if_exists, std::strlen(name), name);
+}
+
+static xcb_atom_t intern_atom_reply(xcb_connection_t *connection,
+                                    xcb_intern_atom_cookie_t cookie)
+{
+    x11::reply<xcb_intern_atom_reply_t> reply(
+        xcb_intern_atom_reply(connection, cookie, nullptr));
+    stats::record(0, 0, x11::reply_size(reply));
+    return reply ? reply->atom : XCB_ATOM_NONE;
+}
+
+// Modes of one size share a name at every rate, so each name is only
+// stored once. A search of the few hundred bytes beats keeping an index.
+static x11::snapshot::range intern_name(std::string &names,
+                                        std::string_view name)
+{
+    size_t offset = names.find(name);
+    if (offset == std::string::npos)
+    {
+        offset = names.size();
+        names.append(name);
+    }
+    return x11::snapshot::range{(uint32_t)offset, (uint32_t)name.size()};
+}
+
+static void decode_modes(resources_lists &result,
+                         const xcb_randr_mode_info_t *mode_infos,
+                         const uint8_t *names,
+                         int nmode)
+{
+    result.modes.reserve(nmode);
+    for (int i = 0; i < nmode; ++i)
+    {
+        const xcb_randr_mode_info_t &info = mode_infos[i];
+        std::string_view name((const char *)names, info.name_len);
+        result.modes.push_back(x11::snapshot::mode{
+            .id = info.id,
+            .width = info.width,
+            .height = info.height,
+            .dot_clock = info.dot_clock,
+            .h_total = info.htotal,
+            .v_total = info.vtotal,
+            .flags = info.mode_flags,
+            .name = intern_name(result.mode_names, name),
+        });
+        names += info.name_len;
+    }
+}
+
+static resources_lists
+decode_resources(const xcb_randr_get_screen_resources_reply_t *resources)
+{
+    const xcb_randr_output_t *outputs =
+        xcb_randr_get_screen_resources_outputs(resources);
+    const xcb_randr_crtc_t *crtcs =
+        xcb_randr_get_screen_resources_crtcs(resources);
+
+    resources_lists result{
+        .timestamp = resources->timestamp,
+        .config_timestamp = resources->config_timestamp,
+        .outputs = std::vector<RROutput>(
+            outputs,
+            outputs + xcb_randr_get_screen_resources_outputs_length(resources)),
+        .crtcs = std::vector<RRCrtc>(
+            crtcs,
+            crtcs + xcb_randr_get_screen_resources_crtcs_length(resources)),
+    };
+    decode_modes(result,
+                 xcb_randr_get_screen_resources_modes(resources),
+                 xcb_randr_get_screen_resources_names(resources),
+                 xcb_randr_get_screen_resources_modes_length(resources));
+    return result;
+}
+
+static resources_lists decode_resources(
+    const xcb_randr_get_screen_resources_current_reply_t *resources)
+{
+    const xcb_randr_output_t *outputs =
+        xcb_randr_get_screen_resources_current_outputs(resources);
+    const xcb_randr_crtc_t *crtcs =
+        xcb_randr_get_screen_resources_current_crtcs(resources);
+
+    resources_lists result{
+        .timestamp = resources->timestamp,
+        .config_timestamp = resources->config_timestamp,
+        .outputs = std::vector<RROutput>(
+            outputs,
+            outputs + xcb_randr_get_screen_resources_current_outputs_length(
+                          resources)),
+        .crtcs = std::vector<RRCrtc>(
+            crtcs,
+            crtcs +
+                xcb_randr_get_screen_resources_current_crtcs_length(resources)),
+    };
+    decode_modes(
+        result,
+        xcb_randr_get_screen_resources_current_modes(resources),
+        xcb_randr_get_screen_resources_current_names(resources),
+        xcb_randr_get_screen_resources_current_modes_length(resources));
+    return result;
+}
+
+// Sends the probing request when `probe` is set; otherwise the server
+// answers from what it last probed.
+static std::optional<resources_lists>
+get_resources(xcb_connection_t *connection, xcb_window_t root, bool probe)
+{
+    stats::record(1, 1, 0);
+
+    if (probe)
+    {
+        x11::reply<xcb_randr_get_screen_resources_reply_t> resources(
+            xcb_randr_get_screen_resources_reply(
+                connection,
+                xcb_randr_get_screen_resources(connection, root),
+                nullptr));
+        stats::record(0, 0, x11::reply_size(resources));
+        if (!resources)
+            return std::nullopt;
+        return decode_resources(resources.get());
+    }
+
+    x11::reply<xcb_randr_get_screen_resources_current_reply_t> resources(
+        xcb_randr_get_screen_resources_current_reply(
+            connection,
+            xcb_randr_get_screen_resources_current(connection, root),
+            nullptr));
+    stats::record(0, 0, x11::reply_size(resources));
+    if (!resources)
+        return std::nullopt;
+    return decode_resources(resources.get());
+}
+
+// A server that has never probed, or has lost track of its outputs, reports
+// nothing useful until it does.
+static bool looks_stale(const resources_lists &resources)
+{
+    return resources.config_timestamp == XCB_CURRENT_TIME ||
+           resources.outputs.empty() || resources.modes.empty();
+}
+
+static output_cookies send_output_requests(xcb_connection_t *connection,
+                                           const x11::snapshot &snapshot,
+                                           RROutput output_id)
+{
+    output_cookies cookies = {};
+
+    cookies.info = xcb_randr_get_output_info(
+        connection, output_id, snapshot.config_timestamp);
+    stats::record(1, 0, 0);
+
+    if (snapshot.edid_property != None)
+    {
+        stats::record(stats::phase::EDID, 1, 0, 0);
+        cookies.edid =
+            xcb_randr_get_output_property(connection,
+                                          output_id,
+                                          snapshot.edid_property,
+                                          XCB_ATOM_ANY,
+                                          0,
+                                          x11::edid_max_length_longs,
+                                          false,
+                                          false);
+    }
+
+    if (snapshot.tearfree_property != None)
+    {
+        stats::record(1, 0, 0);
+        cookies.tearfree =
+            xcb_randr_get_output_property(connection,
+                                          output_id,
+                                          snapshot.tearfree_property,
+                                          XCB_ATOM_ANY,
+                                          0,
+                                          1,
+                                          false,
+                                          false);
+    }
+
+    return cookies;
+}
+
+static display::tearfree
+decode_tearfree(xcb_connection_t *connection,
+                xcb_randr_get_output_property_cookie_t cookie,
+                const Atom (&values)[4])
+{
+    x11::reply<xcb_randr_get_output_property_reply_t> reply(
+        xcb_randr_get_output_property_reply(connection, cookie, nullptr));
+    stats::record(0, 0, x11::reply_size(reply));
+
+    if (!reply || reply->num_items == 0)
+        return display::tearfree::UNSET;
+
+    if (reply->format != 32)
+    {
+        std::cerr << "Format for TearFree isn't a 32-bit integer\n";
+        return display::tearfree::UNSET;
+    }
+
+    xcb_atom_t value;
+    std::memcpy(&value,
+                xcb_randr_get_output_property_data(reply.get()),
+                sizeof(value));
+
+    for (display::tearfree candidate : {display::tearfree::ON,
+                                        display::tearfree::OFF,
+                                        display::tearfree::AUTO})
+    {
+        if (value != None && value == values[(int)candidate])
+            return candidate;
+    }
+    return display::tearfree::UNSET;
+}
+
+static std::vector<uint8_t>
+decode_edid(xcb_connection_t *connection,
+            xcb_randr_get_output_property_cookie_t cookie)
+{
+    x11::reply<xcb_randr_get_output_property_reply_t> reply(
+        xcb_randr_get_output_property_reply(connection, cookie, nullptr));
+    stats::record(stats::phase::EDID, 0, 0, x11::reply_size(reply));
+
+    if (!reply || reply->format != 8)
+        return {};
+
+    const uint8_t *data = xcb_randr_get_output_property_data(reply.get());
+    int length = xcb_randr_get_output_property_data_length(reply.get());
+
+    return std::vector<uint8_t>(data, data + length);
+}
+
+static x11::snapshot::output collect_output(xcb_connection_t *connection,
+                                            const x11::snapshot &snapshot,
+                                            RROutput output_id,
+                                            const output_cookies &cookies)
+{
+    x11::reply<xcb_randr_get_output_info_reply_t> info(
+        xcb_randr_get_output_info_reply(connection, cookies.info, nullptr));
+    stats::record(0, 0, x11::reply_size(info));
+
+    if (!info)
+        throw std::runtime_error("Failed to get XRR output info.");
+
+    const xcb_randr_crtc_t *possible =
+        xcb_randr_get_output_info_crtcs(info.get());
+    const xcb_randr_mode_t *output_modes =
+        xcb_randr_get_output_info_modes(info.get());
+
+    x11::snapshot::output result{
+        .id = output_id,
+        .name = std::string(
+            (const char *)xcb_randr_get_output_info_name(info.get()),
+            xcb_randr_get_output_info_name_length(info.get())),
+        .crtc = info->crtc,
+        .connection = info->connection,
+        .crtcs = std::vector<RRCrtc>(
+            possible,
+            possible + xcb_randr_get_output_info_crtcs_length(info.get())),
+        .modes = std::vector<RRMode>(
+            output_modes,
+            output_modes + xcb_randr_get_output_info_modes_length(info.get())),
+    };
+
+    if (snapshot.edid_property != None)
+        result.edid = decode_edid(connection, cookies.edid);
+
+    // Not every server publishes the property, but outputs named like
+    // their DRM connectors, as modesetting names them, can be read from
+    // sysfs instead.
+    if (result.edid.empty() && result.connection == RR_Connected)
+    {
+        stats::scope scope(stats::phase::EDID);
+        result.edid = edids::read_sysfs(result.name);
+    }
+
+    if (snapshot.tearfree_property != None)
+        result.tearfree = decode_tearfree(
+            connection, cookies.tearfree, snapshot.tearfree_values);
+
+    return result;
+}
+
+namespace x11
+{
+
+snapshot::snapshot(session &sess, bool probe)
+{
+    stats::scope scope(stats::phase::PROBE);
+
+    xcb_connection_t *connection = sess.connection;
+    xcb_window_t root = sess.default_root_window();
+
+    // Round trip one: everything that doesn't depend on the resource list.
+
+    xcb_intern_atom_cookie_t edid_cookie =
+        intern_atom(connection, "EDID", false);
+    xcb_intern_atom_cookie_t tearfree_cookie =
+        intern_atom(connection, "TearFree", true);
+    xcb_intern_atom_cookie_t on_cookie = intern_atom(connection, "on", true);
+    xcb_intern_atom_cookie_t auto_cookie =
+        intern_atom(connection, "auto", true);
+    xcb_intern_atom_cookie_t off_cookie = intern_atom(connection, "off", true);
+    xcb_randr_get_output_primary_cookie_t primary_cookie =
+        xcb_randr_get_output_primary(connection, root);
+    stats::record(6, 0, 0);
+
+    std::optional<resources_lists> resources =
+        get_resources(connection, root, probe);
+
+    // Only costs the probe when the server had nothing current to offer.
+    if (resources && !probe && looks_stale(*resources))
+        resources = get_resources(connection, root, true);
+
+    if (!resources)
+        throw std::runtime_error("Failed to get XRR screen resources.");
+
+    edid_property = intern_atom_reply(connection, edid_cookie);
+    tearfree_property = intern_atom_reply(connection, tearfree_cookie);
+    tearfree_values[(int)display::tearfree::ON] =
+        intern_atom_reply(connection, on_cookie);
+    tearfree_values[(int)display::tearfree::AUTO] =
+        intern_atom_reply(connection, auto_cookie);
+    tearfree_values[(int)display::tearfree::OFF] =
+        intern_atom_reply(connection, off_cookie);
+
+    reply<xcb_randr_get_output_primary_reply_t> primary_reply(
+        xcb_randr_get_output_primary_reply(connection, primary_cookie, nullptr));
+    stats::record(0, 0, reply_size(primary_reply));
+    primary = primary_reply ? primary_reply->output : None;
+
+    int screen = XDefaultScreen(sess.display);
+    screen_size = {(unsigned int)XDisplayWidth(sess.display, screen),
+                   (unsigned int)XDisplayHeight(sess.display, screen)};
+    screen_size_mm = {(unsigned int)XDisplayWidthMM(sess.display, screen),
+                      (unsigned int)XDisplayHeightMM(sess.display, screen)};
+
+    timestamp = resources->timestamp;
+    config_timestamp = resources->config_timestamp;
+    modes = std::move(resources->modes);
+    mode_names = std::move(resources->mode_names);
+
+    // Round trip two: every per-output and per-CRTC request at once.
+
+    const std::vector<RROutput> &output_ids = resources->outputs;
+    const std::vector<RRCrtc> &crtc_ids = resources->crtcs;
+    int noutput = output_ids.size();
+    int ncrtc = crtc_ids.size();
+
+    std::vector<output_cookies> cookies(noutput);
+    std::vector<xcb_randr_get_crtc_info_cookie_t> crtc_cookies(ncrtc);
+
+    for (int i = 0; i < noutput; ++i)
+        cookies[i] = send_output_requests(connection, *this, output_ids[i]);
+
+    for (int i = 0; i < ncrtc; ++i)
+        crtc_cookies[i] =
+            xcb_randr_get_crtc_info(connection, crtc_ids[i], config_timestamp);
+    stats::record(ncrtc, noutput + ncrtc > 0, 0);
+
+    outputs.reserve(noutput);
+    for (int i = 0; i < noutput; ++i)
+        outputs.emplace_back(
+            collect_output(connection, *this, output_ids[i], cookies[i]));
+
+    index_modes();
+
+    crtcs.reserve(ncrtc);
+    for (int i = 0; i < ncrtc; ++i)
+    {
+        reply<xcb_randr_get_crtc_info_reply_t> info(
+            xcb_randr_get_crtc_info_reply(connection, crtc_cookies[i], nullptr));
+        stats::record(0, 0, reply_size(info));
+
+        if (!info)
+        {
+            std::cerr << "Warning: CRTC info not found for CRTC " << crtc_ids[i]
+                      << std::endl;
+            continue;
+        }
+
+        const xcb_randr_output_t *crtc_outputs =
+            xcb_randr_get_crtc_info_outputs(info.get());
+
+        crtcs.push_back(crtc{
+            .id = crtc_ids[i],
+            .x = info->x,
+            .y = info->y,
+            .width = info->width,
+            .height = info->height,
+            .mode = info->mode,
+            .rotation = info->rotation,
+            .outputs = std::vector<RROutput>(
+                crtc_outputs,
+                crtc_outputs +
+                    xcb_randr_get_crtc_info_outputs_length(info.get())),
+        });
+    }
+}
+
+void snapshot::refresh(session &sess, const std::vector<RROutput> &output_ids)
+{
+    stats::scope scope(stats::phase::PROBE);
+
+    xcb_connection_t *connection = sess.connection;
+
+    std::vector<output_cookies> cookies;
+    cookies.reserve(output_ids.size());
+    for (RROutput output_id : output_ids)
+        cookies.push_back(send_output_requests(connection, *this, output_id));
+
+    // The current resources never trigger a hardware probe; the server has
+    // already probed whatever caused the change being refreshed.
+    std::optional<resources_lists> resources =
+        get_resources(connection, sess.default_root_window(), false);
+
+    if (!resources)
+        throw std::runtime_error("Failed to get XRR screen resources.");
+
+    timestamp = resources->timestamp;
+    config_timestamp = resources->config_timestamp;
+    modes = std::move(resources->modes);
+    mode_names = std::move(resources->mode_names);
+
+    for (size_t i = 0; i < output_ids.size(); ++i)
+    {
+        output refreshed =
+            collect_output(connection, *this, output_ids[i], cookies[i]);
+
+        output *existing = find_output(refreshed.id);
+
+        if (existing)
+            *existing = std::move(refreshed);
+        else
+            outputs.emplace_back(std::move(refreshed));
+    }
+
+    // Outputs come and go with MST hubs: anything gone is dropped, and
+    // anything new costs one more round trip.
+
+    const std::vector<RROutput> &current_ids = resources->outputs;
+
+    std::erase_if(outputs, [&](const output &output) {
+        return std::find(current_ids.begin(), current_ids.end(), output.id) ==
+               current_ids.end();
+    });
+
+    std::vector<RROutput> added;
+    for (RROutput output_id : current_ids)
+    {
+        if (!find_output(output_id))
+            added.push_back(output_id);
+    }
+
+    if (!added.empty())
+        refresh(sess, added);
+    else
+        index_modes();
+}
+
+void snapshot::index_modes()
+{
+    mode_ids.clear();
+    mode_ids.reserve(modes.size());
+    for (size_t i = 0; i < modes.size(); ++i)
+    {
+        mode_ids.emplace(modes[i].id, i);
+        modes[i].rate = modes[i].timing().exact_rate();
+    }
+
+    size_t total = 0;
+    for (const output &output : outputs)
+        total += output.modes.size();
+
+    mode_tables.clear();
+    mode_tables.reserve(total);
+
+    for (output &output : outputs)
+    {
+        size_t begin = mode_tables.size();
+
+        for (RRMode mode_id : output.modes)
+        {
+            auto it = mode_ids.find(mode_id);
+            if (it != mode_ids.end())
+                mode_tables.push_back(it->second);
+        }
+
+        // Stable, so modes of one size and rate stay in preference order.
+        std::stable_sort(mode_tables.begin() + begin,
+                         mode_tables.end(),
+                         [&](uint32_t a, uint32_t b) {
+                             return std::tie(modes[a].width,
+                                             modes[a].height,
+                                             modes[a].rate) <
+                                    std::tie(modes[b].width,
+                                             modes[b].height,
+                                             modes[b].rate);
+                         });
+
+        output.mode_table = range{(uint32_t)begin,
+                                  (uint32_t)(mode_tables.size() - begin)};
+    }
+}
+
+void snapshot::add_mode(const mode &mode, std::string_view name)
+{
+    modes.push_back(mode);
+    modes.back().name = intern_name(mode_names, name);
+}
+
+const snapshot::mode *snapshot::find_mode(RRMode mode_id) const
+{
+    auto it = mode_ids.find(mode_id);
+    if (it == mode_ids.end())
+        return nullptr;
+    return &modes[it->second];
+}
+
+const snapshot::crtc *snapshot::find_crtc(RRCrtc crtc_id) const
+{
+    for (const crtc &crtc : crtcs)
+    {
+        if (crtc.id == crtc_id)
+            return &crtc;
+    }
+    return nullptr;
+}
+
+snapshot::crtc *snapshot::find_crtc(RRCrtc crtc_id)
+{
+    return const_cast<crtc *>(std::as_const(*this).find_crtc(crtc_id));
+}
+
+const snapshot::output *snapshot::find_output(RROutput output_id) const
+{
+    for (const output &output : outputs)
+    {
+        if (output.id == output_id)
+            return &output;
+    }
+    return nullptr;
+}
+
+snapshot::output *snapshot::find_output(RROutput output_id)
+{
+    return const_cast<output *>(std::as_const(*this).find_output(output_id));
+}
+
+} // namespace x11
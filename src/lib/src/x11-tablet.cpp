@@ -0,0 +1,278 @@
+#include "tablet.hpp"
+
+#include <stdexcept>
+
+static void multiply_matrices(float result[3][3], float a[3][3], float b[3][3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            result[i][j] = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                result[i][j] += a[i][k] * b[k][j];
+            }
+        }
+    }
+}
+
+static void generate_transform_matrix(display::state state,
+                                      float transform_matrix[3][3])
+{
+    // Initialize identity matrix
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            transform_matrix[i][j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+
+    // Translate matrix
+    float translate[3][3] = {
+        {1, 0, (float)state.position.x},
+        {0, 1, (float)state.position.y},
+        {0, 0, 1},
+    };
+
+    // Rotation matrix
+    float rotation[3][3] = {
+        {1, 0, 0},
+        {0, 1, 0},
+        {0, 0, 1},
+    };
+
+    float scale[3][3] = {
+        {(float)state.mode.width, 0, 0},
+        {0, (float)state.mode.height, 0},
+        {0, 0, 1},
+    };
+
+#ifndef M_PI
+#define M_PI 3.14159
+#endif
+
+    if (state.rotation == display::rotation::RIGHT)
+    {
+        rotation[0][0] = 0;
+        rotation[0][1] = -1;
+        rotation[1][0] = 1;
+        rotation[1][1] = 0;
+    }
+    else if (state.rotation == display::rotation::INVERTED)
+    {
+        rotation[0][0] = -1;
+        rotation[0][1] = 0;
+        rotation[1][0] = 0;
+        rotation[1][1] = -1;
+    }
+    else if (state.rotation == display::rotation::LEFT)
+    {
+        rotation[0][0] = 0;
+        rotation[0][1] = 1;
+        rotation[1][0] = -1;
+        rotation[1][1] = 0;
+    }
+
+    float temp[3][3];
+    multiply_matrices(temp, rotation, translate);
+    multiply_matrices(transform_matrix, temp, scale);
+}
+
+namespace x11
+{
+device_info::device_info(session &sess)
+{
+    contents = XListInputDevices(sess.display, &ndevices);
+}
+device_info::~device_info()
+{
+    XFreeDeviceList(contents);
+}
+XDeviceInfo *device_info::operator[](const std::string &name) const
+{
+    for (int i = 0; i < ndevices; ++i)
+    {
+        if (name == (std::string)contents[i].name)
+        {
+            return &contents[i];
+        }
+    }
+    return nullptr;
+}
+xi_device_info::xi_device_info(session &sess, XID device_id)
+{
+    int ndevices;
+    contents = XIQueryDevice(sess.display, device_id, &ndevices);
+    if (!contents)
+        throw std::runtime_error("Failed to get XI device info.");
+}
+xi_device_info::~xi_device_info()
+{
+    XIFreeDeviceInfo(contents);
+}
+XIDeviceInfo *xi_device_info::operator[](const std::string &name) const
+{
+    for (int i = 0; i < contents->num_classes; ++i)
+    {
+        if (name == (std::string)contents[i].name)
+        {
+            return &contents[i];
+        }
+    }
+    return nullptr;
+}
+XIDeviceInfo *xi_device_info::operator->() const
+{
+    return contents;
+}
+display::vec2<uint32_t> xi_device_info::get_tablet_dimensions() const
+{
+    display::vec2<uint32_t> result = {0, 0};
+
+    XIAnyClassInfo **classes = contents->classes;
+
+    for (int i = 0; i < contents->num_classes; ++i)
+    {
+        if (classes[i]->type == XIValuatorClass)
+        {
+            XIValuatorClassInfo *valuator = (XIValuatorClassInfo *)classes[i];
+
+            if (valuator->number == 0) // X axis
+            {
+                result.x = valuator->max - valuator->min;
+            }
+            else if (valuator->number == 1) // Y axis
+            {
+                result.y = valuator->max - valuator->min;
+            }
+        }
+    }
+
+    return result;
+}
+
+std::string xi_device_info::get_name() const
+{
+    if (!contents->name)
+        throw std::runtime_error("XI device has no name.");
+    return contents->name;
+}
+x_device::x_device(session &sess, XDeviceInfo *device_info)
+{
+    contents = XOpenDevice(sess.display, device_info->id);
+    if (!contents)
+        throw std::runtime_error("Failed to open X device.");
+    display = sess.display;
+}
+x_device::~x_device()
+{
+    XCloseDevice(display, contents);
+}
+XDevice *x_device::operator->() const
+{
+    return contents;
+}
+
+bool x_device::set_coodinate_transformation_matrix(const float matrix[3][3])
+{
+    Atom matrix_prop =
+        XInternAtom(display, "Coordinate Transformation Matrix", False);
+    if (matrix_prop == None)
+        return false;
+
+    const float *float_matrix = &matrix[0][0];
+
+    long long_matrix[9];
+
+    for (int i = 0; i < 9; i++)
+    {
+        *(float *)(long_matrix + i) = float_matrix[i];
+    }
+
+    Atom type;
+    int format;
+    unsigned long nitems;
+    unsigned long bytes_after;
+    float *data;
+    XGetDeviceProperty(display,
+                       contents,
+                       matrix_prop,
+                       0,
+                       9,
+                       False,
+                       AnyPropertyType,
+                       &type,
+                       &format,
+                       &nitems,
+                       &bytes_after,
+                       (unsigned char **)&data);
+
+    if (format != 32 || type != XInternAtom(display, "FLOAT", True))
+
+    {
+        if (data)
+            XFree(data);
+
+        return false;
+    }
+
+    XChangeDeviceProperty(display,
+                          contents,
+                          matrix_prop,
+                          type,
+                          format,
+                          PropModeReplace,
+                          (unsigned char *)matrix,
+                          9);
+
+    XFree(data);
+    XFlush(display);
+
+    return true;
+}
+bool map_tablet_to_output(const std::string &tablet_name,
+                          const std::string &output_name)
+{
+    session x11;
+    snapshot current(x11);
+    device_info devices(x11);
+
+    XDeviceInfo *tablet_device_info = devices[tablet_name];
+
+    if (!tablet_device_info)
+        return false;
+
+    for (const snapshot::output &info : current.outputs)
+    {
+        if (info.connection != RR_Connected)
+            continue;
+
+        display::output output;
+        to_output(current, info, output);
+
+        if (std::string_view(output.name) != output_name &&
+            !(output.edid.digest == output_name))
+            continue;
+
+        display::state state = output;
+
+        xi_device_info xi_device_info(x11, tablet_device_info->id);
+        display::vec2<uint32_t> tablet_dimensions =
+            xi_device_info.get_tablet_dimensions();
+        if (tablet_dimensions.x == 0 || tablet_dimensions.y == 0)
+            return false;
+
+        float transform_matrix[3][3];
+        generate_transform_matrix(state, transform_matrix);
+
+        x_device tablet_device(x11, tablet_device_info);
+
+        return tablet_device.set_coodinate_transformation_matrix(
+            transform_matrix);
+    }
+    return false;
+}
+
+} // namespace x11
@@ -0,0 +1,333 @@
+#include "x11.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+
+// Requests whose failure is only known once their reply or error is read.
+struct pending
+{
+    std::vector<xcb_randr_set_crtc_config_cookie_t> crtc_configs;
+    std::vector<xcb_void_cookie_t> checked;
+};
+
+class server_grab
+{
+    xcb_connection_t *connection;
+
+  public:
+    explicit server_grab(xcb_connection_t *connection) : connection(connection)
+    {
+        stats::record(1, 0, 4);
+        xcb_grab_server(connection);
+    }
+    ~server_grab()
+    {
+        stats::record(1, 0, 4);
+        xcb_ungrab_server(connection);
+        xcb_flush(connection);
+    }
+
+    server_grab(const server_grab &) = delete;
+    server_grab &operator=(const server_grab &) = delete;
+};
+
+} // namespace
+
+static bool fits(const x11::crtc_config &config,
+                 const display::vec2<unsigned int> &screen_size)
+{
+    return config.x + config.width <= screen_size.x &&
+           config.y + config.height <= screen_size.y;
+}
+
+static x11::crtc_config current_config(const x11::snapshot::crtc &crtc)
+{
+    return x11::crtc_config{
+        .crtc = crtc.id,
+        .x = crtc.x,
+        .y = crtc.y,
+        .mode = crtc.mode,
+        .rotation = crtc.rotation,
+        .outputs = crtc.mode == None ? std::vector<RROutput>{} : crtc.outputs,
+        .width = crtc.width,
+        .height = crtc.height,
+    };
+}
+
+static void send_crtc_config(xcb_connection_t *connection,
+                             const x11::snapshot &before,
+                             const x11::crtc_config &config,
+                             pending &requests)
+{
+    bool disable = config.mode == None;
+    std::vector<xcb_randr_output_t> outputs;
+    if (!disable)
+        outputs.assign(config.outputs.begin(), config.outputs.end());
+
+    stats::record(1, 0, 28 + 4 * outputs.size());
+    requests.crtc_configs.push_back(
+        xcb_randr_set_crtc_config(connection,
+                                  config.crtc,
+                                  XCB_CURRENT_TIME,
+                                  before.config_timestamp,
+                                  disable ? 0 : config.x,
+                                  disable ? 0 : config.y,
+                                  config.mode,
+                                  disable ? RR_Rotate_0 : config.rotation,
+                                  outputs.size(),
+                                  outputs.data()));
+}
+
+static void send_screen_size(xcb_connection_t *connection,
+                             xcb_window_t root,
+                             const display::vec2<unsigned int> &size,
+                             const display::vec2<unsigned int> &size_mm,
+                             pending &requests)
+{
+    stats::record(1, 0, 20);
+    requests.checked.push_back(xcb_randr_set_screen_size_checked(
+        connection, root, size.x, size.y, size_mm.x, size_mm.y));
+}
+
+static void send_tearfree(xcb_connection_t *connection,
+                          const x11::snapshot &before,
+                          RROutput output,
+                          display::tearfree value,
+                          pending &requests)
+{
+    if (value == display::tearfree::UNSET)
+        return;
+
+    Atom atom_value = before.tearfree_values[(int)value];
+
+    if (before.tearfree_property == None || atom_value == None)
+    {
+        std::cerr << "Couldn't get atom names\n";
+        return;
+    }
+
+    uint32_t data = atom_value;
+    stats::record(1, 0, 28);
+    requests.checked.push_back(
+        xcb_randr_change_output_property_checked(connection,
+                                                 output,
+                                                 before.tearfree_property,
+                                                 XCB_ATOM_ATOM,
+                                                 32,
+                                                 XCB_PROP_MODE_REPLACE,
+                                                 1,
+                                                 &data));
+}
+
+// Reads every outstanding reply, returning false if any request failed.
+static bool collect(xcb_connection_t *connection, pending &requests)
+{
+    bool ok = true;
+
+    // Every request is answered by the time the first reply arrives.
+    if (!requests.crtc_configs.empty() || !requests.checked.empty())
+        stats::record(0, 1, 0);
+
+    for (xcb_randr_set_crtc_config_cookie_t cookie : requests.crtc_configs)
+    {
+        xcb_generic_error_t *error = nullptr;
+        x11::reply<xcb_randr_set_crtc_config_reply_t> reply(
+            xcb_randr_set_crtc_config_reply(connection, cookie, &error));
+        stats::record(0, 0, x11::reply_size(reply));
+
+        if (error)
+        {
+            std::cerr << "Warning: RRSetCrtcConfig failed with X error "
+                      << (int)error->error_code << std::endl;
+            std::free(error);
+            ok = false;
+        }
+        else if (!reply || reply->status != XCB_RANDR_SET_CONFIG_SUCCESS)
+        {
+            std::cerr << "Warning: RRSetCrtcConfig returned status "
+                      << (reply ? (int)reply->status : -1) << std::endl;
+            ok = false;
+        }
+    }
+
+    for (xcb_void_cookie_t cookie : requests.checked)
+    {
+        xcb_generic_error_t *error = xcb_request_check(connection, cookie);
+        if (error)
+        {
+            std::cerr << "Warning: RandR request failed with X error "
+                      << (int)error->error_code << std::endl;
+            std::free(error);
+            ok = false;
+        }
+    }
+
+    requests = {};
+
+    return ok;
+}
+
+static display::vec2<unsigned int>
+target_screen_size(const x11::snapshot &before, const x11::layout &target)
+{
+    if (target.screen_size.x > 0 && target.screen_size.y > 0)
+        return target.screen_size;
+    return before.screen_size;
+}
+
+// Anything being disabled, and anything being reconfigured that currently
+// lies outside the new screen, has to go dark before the resize.
+static bool needs_shrink(const x11::snapshot &before,
+                         const x11::crtc_config &want,
+                         const display::vec2<unsigned int> &screen_size)
+{
+    const x11::snapshot::crtc *have = before.find_crtc(want.crtc);
+    if (!have || have->mode == None)
+        return false;
+
+    return want.mode == None || !fits(current_config(*have), screen_size);
+}
+
+static bool needs_resize(const x11::snapshot &before,
+                         const display::vec2<unsigned int> &screen_size)
+{
+    return screen_size.x != before.screen_size.x ||
+           screen_size.y != before.screen_size.y;
+}
+
+namespace x11
+{
+
+size_t count_requests(const snapshot &before, const layout &target)
+{
+    if (target.empty())
+        return 0;
+
+    display::vec2<unsigned int> screen_size = target_screen_size(before, target);
+    size_t count = needs_resize(before, screen_size) ? 1 : 0;
+
+    for (const crtc_config &want : target.crtcs)
+        count += needs_shrink(before, want, screen_size) + (want.mode != None);
+
+    if (target.primary != None)
+        ++count;
+
+    for (const auto &[output, value] : target.tearfree)
+        count += value != display::tearfree::UNSET;
+
+    return count;
+}
+
+transaction::transaction(session &_sess, const snapshot &_before)
+    : sess(_sess), before(_before)
+{
+}
+
+size_t transaction::commit(const layout &target)
+{
+    if (target.empty())
+        return 0;
+
+    stats::scope scope(stats::phase::APPLY);
+
+    xcb_connection_t *connection = sess.connection;
+    xcb_window_t root = sess.default_root_window();
+
+    display::vec2<unsigned int> screen_size = target_screen_size(before, target);
+    display::vec2<unsigned int> screen_size_mm =
+        needs_resize(before, screen_size) ? target.screen_size_mm
+                                          : before.screen_size_mm;
+
+    server_grab grab(connection);
+    pending requests;
+
+    // Shrink.
+
+    for (const crtc_config &want : target.crtcs)
+    {
+        if (needs_shrink(before, want, screen_size))
+            send_crtc_config(
+                connection, before, crtc_config{want.crtc}, requests);
+    }
+
+    // Resize.
+
+    if (needs_resize(before, screen_size))
+        send_screen_size(
+            connection, root, screen_size, screen_size_mm, requests);
+
+    // Grow.
+
+    for (const crtc_config &want : target.crtcs)
+    {
+        if (want.mode != None)
+            send_crtc_config(connection, before, want, requests);
+    }
+
+    if (target.primary != None)
+    {
+        stats::record(1, 0, 12);
+        requests.checked.push_back(xcb_randr_set_output_primary_checked(
+            connection, root, target.primary));
+    }
+
+    for (const auto &[output, value] : target.tearfree)
+        send_tearfree(connection, before, output, value, requests);
+
+    size_t sent = requests.crtc_configs.size() + requests.checked.size();
+
+    if (collect(connection, requests))
+        return sent;
+
+    // Rollback: park every CRTC the layout touched, restore the old screen
+    // size, then bring the previous configuration back.
+
+    std::cerr << "Warning: Failed to apply display configuration; restoring "
+                 "the previous one."
+              << std::endl;
+
+    for (const crtc_config &want : target.crtcs)
+        send_crtc_config(
+            connection, before, crtc_config{want.crtc}, requests);
+
+    send_screen_size(
+        connection, root, before.screen_size, before.screen_size_mm, requests);
+
+    for (const crtc_config &want : target.crtcs)
+    {
+        const snapshot::crtc *have = before.find_crtc(want.crtc);
+        if (have && have->mode != None)
+            send_crtc_config(
+                connection, before, current_config(*have), requests);
+    }
+
+    // A primary the layout set is cleared again when there was none.
+    if (before.primary != None || target.primary != None)
+    {
+        stats::record(1, 0, 12);
+        requests.checked.push_back(xcb_randr_set_output_primary_checked(
+            connection, root, before.primary));
+    }
+
+    for (const auto &[output, value] : target.tearfree)
+    {
+        for (const snapshot::output &have : before.outputs)
+        {
+            if (have.id == output)
+                send_tearfree(
+                    connection, before, have.id, have.tearfree, requests);
+        }
+    }
+
+    if (!collect(connection, requests))
+        std::cerr << "Warning: Failed to restore the previous display "
+                     "configuration."
+                  << std::endl;
+
+    throw std::runtime_error("Failed to apply display configuration.");
+}
+
+} // namespace x11
@@ -0,0 +1,127 @@
+#include "x11.hpp"
+
+#include <algorithm>
+#include <poll.h>
+
+static void detach_output(x11::snapshot &snapshot, RROutput output_id)
+{
+    for (x11::snapshot::crtc &crtc : snapshot.crtcs)
+        std::erase(crtc.outputs, output_id);
+}
+
+namespace x11
+{
+
+watcher::watcher(session &_sess, snapshot &_current)
+    : sess(_sess), current(_current)
+{
+    XRRSelectInput(sess.display,
+                   sess.default_root_window(),
+                   RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask |
+                       RROutputChangeNotifyMask | RROutputPropertyNotifyMask);
+    XFlush(sess.display);
+}
+
+void watcher::handle(XEvent &event)
+{
+    XRRUpdateConfiguration(&event);
+
+    if (event.type == sess.randr_event_base + RRScreenChangeNotify)
+    {
+        auto *change = (XRRScreenChangeNotifyEvent *)&event;
+        current.screen_size = {(unsigned int)change->width,
+                               (unsigned int)change->height};
+        current.screen_size_mm = {(unsigned int)change->mwidth,
+                                  (unsigned int)change->mheight};
+        current.timestamp = change->timestamp;
+        current.config_timestamp = change->config_timestamp;
+        return;
+    }
+
+    if (event.type != sess.randr_event_base + RRNotify)
+        return;
+
+    auto *notify = (XRRNotifyEvent *)&event;
+
+    switch (notify->subtype)
+    {
+    case RRNotify_CrtcChange:
+    {
+        auto *change = (XRRCrtcChangeNotifyEvent *)&event;
+        snapshot::crtc *crtc = current.find_crtc(change->crtc);
+        if (!crtc)
+            break;
+        crtc->mode = change->mode;
+        crtc->rotation = change->rotation;
+        crtc->x = change->x;
+        crtc->y = change->y;
+        crtc->width = change->width;
+        crtc->height = change->height;
+        if (change->mode == None)
+            crtc->outputs.clear();
+        break;
+    }
+    case RRNotify_OutputChange:
+    {
+        auto *change = (XRROutputChangeNotifyEvent *)&event;
+        snapshot::output *output = current.find_output(change->output);
+
+        if (!output || output->connection != change->connection)
+            dirty.push_back(change->output);
+
+        if (!output)
+            break;
+
+        output->connection = change->connection;
+        output->crtc = change->crtc;
+
+        detach_output(current, change->output);
+        snapshot::crtc *crtc = current.find_crtc(change->crtc);
+        if (crtc)
+            crtc->outputs.push_back(change->output);
+        break;
+    }
+    case RRNotify_OutputProperty:
+    {
+        auto *change = (XRROutputPropertyNotifyEvent *)&event;
+        if (change->property == current.edid_property ||
+            change->property == current.tearfree_property)
+            dirty.push_back(change->output);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void watcher::wait(int settle_ms)
+{
+    XEvent event;
+    XNextEvent(sess.display, &event);
+    handle(event);
+
+    // Docks emit a burst of events for one plug; keep absorbing them until
+    // the connection stays quiet for the settle time.
+
+    pollfd fd = {.fd = ConnectionNumber(sess.display), .events = POLLIN};
+
+    do
+    {
+        while (XPending(sess.display))
+        {
+            XNextEvent(sess.display, &event);
+            handle(event);
+        }
+    } while (poll(&fd, 1, settle_ms) > 0);
+
+    if (dirty.empty())
+        return;
+
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    current.refresh(sess, dirty);
+    dirty.clear();
+}
+
+} // namespace x11
@@ -3,8 +3,6 @@
 #include <dman/display.hpp>
 #include <X11/Xlib.h>
 #include <X11/extensions/Xrandr.h>
-#include <X11/extensions/XInput.h>
-#include <X11/extensions/XInput2.h>
 #include <cassert>
 #include <dman/config.hpp>
 #include <stdexcept>
@@ -29,17 +27,24 @@ namespace x11
 {
 session::session()
 {
+    stats::scope scope(stats::phase::CONNECT);
+
     XSetErrorHandler(x_error_handler);
     display = XOpenDisplay(nullptr);
     if (!display)
         throw std::runtime_error("Failed to open X display.");
-    int event_base, error_base;
-    if (!XRRQueryExtension(display, &event_base, &error_base))
+    int error_base;
+    if (!XRRQueryExtension(display, &randr_event_base, &error_base))
         throw std::runtime_error(
             "X RandR extension not available on this display.");
     int major, minor;
     XRRQueryVersion(display, &major, &minor);
     primary_output = XRRGetOutputPrimary(display, default_root_window());
+    connection = XGetXCBConnection(display);
+
+    // The connection setup, then one reply each for the extension query,
+    // the version and the primary output.
+    stats::record(3, 4, 0);
 }
 session::~session()
 {
@@ -51,307 +56,4 @@ Window session::default_root_window() const
     return XDefaultRootWindow(display);
 }
 
-screen_resources::screen_resources(session &sess)
-{
-    contents = XRRGetScreenResources(sess.display, sess.default_root_window());
-    if (!contents)
-        throw std::runtime_error("Failed to get XRR screen resources.");
-}
-screen_resources::~screen_resources()
-{
-    XRRFreeScreenResources(contents);
-}
-XRRScreenResources *screen_resources::operator->() const
-{
-    return contents;
-}
-screen_resources::operator XRRScreenResources *() const
-{
-    return contents;
-}
-
-XRRModeInfo *screen_resources::find_mode_info(RRMode mode_id) const
-{
-    for (int i = 0; i < contents->nmode; ++i)
-    {
-        if (contents->modes[i].id == mode_id)
-        {
-            return &contents->modes[i];
-        }
-    }
-    return nullptr;
-}
-
-output_id::output_id(session &sess,
-                     screen_resources &resources,
-                     uint32_t output_index)
-{
-    if (output_index >= resources->noutput)
-        throw std::out_of_range("Output index out of range.");
-    contents = resources->outputs[output_index];
-    if (contents == None)
-        throw std::runtime_error("Output is None.");
-}
-output_id::operator RROutput() const
-{
-    return contents;
-}
-output_info::output_info(session &sess,
-                         screen_resources &resources,
-                         const output_id &output)
-{
-    if ((RROutput)output == None)
-        throw std::runtime_error("Output is None.");
-
-    contents = XRRGetOutputInfo(sess.display, resources, output);
-
-    if (!contents)
-        throw std::runtime_error("Failed to get XRR output info.");
-}
-output_info::~output_info()
-{
-    XRRFreeOutputInfo(contents);
-}
-XRROutputInfo *output_info::operator->() const
-{
-    return contents;
-}
-
-crtc_info::crtc_info(session &sess, screen_resources &resources, RRCrtc crtc)
-{
-    contents = XRRGetCrtcInfo(sess.display, resources, crtc);
-}
-crtc_info::~crtc_info()
-{
-    XRRFreeCrtcInfo(contents);
-}
-
-XRRCrtcInfo *crtc_info::operator->() const
-{
-    return contents;
-}
-crtc_info::operator bool() const
-{
-    return contents != nullptr;
-}
-device_info::device_info(session &sess)
-{
-    contents = XListInputDevices(sess.display, &ndevices);
-}
-device_info::~device_info()
-{
-    XFreeDeviceList(contents);
-}
-XDeviceInfo *device_info::operator[](const std::string &name) const
-{
-    for (int i = 0; i < ndevices; ++i)
-    {
-        if (name == (std::string)contents[i].name)
-        {
-            return &contents[i];
-        }
-    }
-    return nullptr;
-}
-xi_device_info::xi_device_info(session &sess, XID device_id)
-{
-    int ndevices;
-    contents = XIQueryDevice(sess.display, device_id, &ndevices);
-    if (!contents)
-        throw std::runtime_error("Failed to get XI device info.");
-}
-xi_device_info::~xi_device_info()
-{
-    XIFreeDeviceInfo(contents);
-}
-XIDeviceInfo *xi_device_info::operator[](const std::string &name) const
-{
-    for (int i = 0; i < contents->num_classes; ++i)
-    {
-        if (name == (std::string)contents[i].name)
-        {
-            return &contents[i];
-        }
-    }
-    return nullptr;
-}
-XIDeviceInfo *xi_device_info::operator->() const
-{
-    return contents;
-}
-display::vec2<uint32_t> xi_device_info::get_tablet_dimensions() const
-{
-    display::vec2<uint32_t> result = {0, 0};
-
-    XIAnyClassInfo **classes = contents->classes;
-
-    for (int i = 0; i < contents->num_classes; ++i)
-    {
-        if (classes[i]->type == XIValuatorClass)
-        {
-            XIValuatorClassInfo *valuator = (XIValuatorClassInfo *)classes[i];
-
-            if (valuator->number == 0) // X axis
-            {
-                result.x = valuator->max - valuator->min;
-            }
-            else if (valuator->number == 1) // Y axis
-            {
-                result.y = valuator->max - valuator->min;
-            }
-        }
-    }
-
-    return result;
-}
-
-std::string xi_device_info::get_name() const
-{
-    if (!contents->name)
-        throw std::runtime_error("XI device has no name.");
-    return contents->name;
-}
-x_device::x_device(session &sess, XDeviceInfo *device_info)
-{
-    contents = XOpenDevice(sess.display, device_info->id);
-    if (!contents)
-        throw std::runtime_error("Failed to open X device.");
-    display = sess.display;
-}
-x_device::~x_device()
-{
-    XCloseDevice(display, contents);
-}
-XDevice *x_device::operator->() const
-{
-    return contents;
-}
-
-bool x_device::set_coodinate_transformation_matrix(const float matrix[3][3])
-{
-    Atom matrix_prop =
-        XInternAtom(display, "Coordinate Transformation Matrix", False);
-    if (matrix_prop == None)
-        return false;
-
-    const float *float_matrix = &matrix[0][0];
-
-    long long_matrix[9];
-
-    for (int i = 0; i < 9; i++)
-    {
-        *(float *)(long_matrix + i) = float_matrix[i];
-    }
-
-    Atom type;
-    int format;
-    unsigned long nitems;
-    unsigned long bytes_after;
-    float *data;
-    XGetDeviceProperty(display,
-                       contents,
-                       matrix_prop,
-                       0,
-                       9,
-                       False,
-                       AnyPropertyType,
-                       &type,
-                       &format,
-                       &nitems,
-                       &bytes_after,
-                       (unsigned char **)&data);
-
-    if (format != 32 || type != XInternAtom(display, "FLOAT", True))
-
-    {
-        if (data)
-            XFree(data);
-
-        return false;
-    }
-
-    XChangeDeviceProperty(display,
-                          contents,
-                          matrix_prop,
-                          type,
-                          format,
-                          PropModeReplace,
-                          (unsigned char *)matrix,
-                          9);
-
-    XFree(data);
-    XFlush(display);
-
-    return true;
-}
-
-RRCrtc find_unused_crtc(x11::session &x11, x11::screen_resources &resources)
-{
-    for (int i = 0; i < resources->ncrtc; ++i)
-    {
-        XRRCrtcInfo *crtc_info =
-            XRRGetCrtcInfo(x11.display, resources, resources->crtcs[i]);
-        if (crtc_info && crtc_info->mode == None)
-        {
-            XRRFreeCrtcInfo(crtc_info);
-            return resources->crtcs[i];
-        }
-        XRRFreeCrtcInfo(crtc_info);
-    }
-    throw std::runtime_error("No unused CRTC found.");
-}
-
-crtc::crtc(session &_sess, screen_resources &_resources, RRCrtc crtc)
-    : sess(_sess), resources(_resources),
-      contents(crtc ? crtc : find_unused_crtc(sess, resources))
-{
-}
-
-crtc::crtc(session &_sess, screen_resources &_resources)
-    : sess(_sess), resources(_resources),
-      contents(find_unused_crtc(sess, resources))
-{
-}
-
-crtc::operator RRCrtc() const
-{
-    return contents;
-}
-
-void crtc::set_config(int x,
-                      int y,
-                      RRMode mode,
-                      Rotation rotation,
-                      unsigned int output_index,
-                      int noutputs)
-{
-    if (mode == None)
-        throw std::runtime_error("Mode is None");
-
-    XRRSetCrtcConfig(sess.display,
-                     resources,
-                     contents,
-                     CurrentTime,
-                     x,
-                     y,
-                     mode,
-                     rotation,
-                     &resources->outputs[output_index],
-                     noutputs);
-}
-
-void crtc::clear()
-{
-    XRRSetCrtcConfig(sess.display,
-                     resources,
-                     contents,
-                     CurrentTime,
-                     0,
-                     0,
-                     None,
-                     RR_Rotate_0,
-                     nullptr,
-                     0);
-}
-
 } // namespace x11
@@ -1,22 +1,55 @@
 #pragma once
 
+#include "module.hpp"
+
 #include <dman/display.hpp>
+#include <dman/stats.hpp>
 #include <X11/Xlib.h>
 #include <X11/extensions/Xrandr.h>
-#include <X11/extensions/XInput.h>
-#include <X11/extensions/XInput2.h>
 #include <X11/Xatom.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/randr.h>
 #include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace x11
 {
 
+struct reply_deleter
+{
+    void operator()(void *reply) const
+    {
+        std::free(reply);
+    }
+};
+
+template <typename T> using reply = std::unique_ptr<T, reply_deleter>;
+
+// Large enough for any EDID, including every extension block, so the
+// property can be read in one request instead of a size query followed by
+// a fetch.
+inline constexpr uint32_t edid_max_length_longs = 32768 / 4;
+
+// Bytes a reply took on the wire, for stats.
+template <typename T> uint64_t reply_size(const reply<T> &reply)
+{
+    return reply ? 32 + 4 * (uint64_t)reply->length : 0;
+}
+
 class session
 {
   public:
     Display *display;
+    xcb_connection_t *connection;
     RROutput primary_output;
+    int randr_event_base;
 
     session();
     ~session();
@@ -27,120 +60,235 @@ class session
     Window default_root_window() const;
 };
 
-class screen_resources
+// A complete RandR state snapshot fetched over xcb. Every request is sent
+// before any reply is read, so a probe costs two round trips no matter how
+// many outputs and CRTCs the server has.
+class snapshot
 {
-    XRRScreenResources *contents;
-
   public:
-    explicit screen_resources(session &sess);
-    ~screen_resources();
-
-    XRRScreenResources *operator->() const;
-    operator XRRScreenResources *() const;
-
-    screen_resources(const screen_resources &) = delete;
-    screen_resources &operator=(const screen_resources &) = delete;
-
-    XRRModeInfo *find_mode_info(RRMode mode_id) const;
+    // A run of one of the snapshot's shared arrays.
+    struct range
+    {
+        uint32_t begin = 0;
+        uint32_t size = 0;
+    };
+
+    // Plain data, so the modes of a snapshot copy as one block however
+    // many outputs list them.
+    struct mode
+    {
+        RRMode id;
+        unsigned int width;
+        unsigned int height;
+        unsigned long dot_clock;
+        unsigned int h_total;
+        unsigned int v_total;
+        unsigned long flags;
+        // Of mode_names.
+        range name;
+        // Worked out by index_modes.
+        display::rational_rate rate;
+
+        display::timing timing() const
+        {
+            return display::timing{
+                dot_clock, h_total, v_total, (uint32_t)flags};
+        }
+    };
+
+    struct crtc
+    {
+        RRCrtc id;
+        int x;
+        int y;
+        unsigned int width;
+        unsigned int height;
+        RRMode mode;
+        Rotation rotation;
+        std::vector<RROutput> outputs;
+    };
+
+    struct output
+    {
+        RROutput id;
+        std::string name;
+        RRCrtc crtc;
+        Connection connection;
+        std::vector<RRCrtc> crtcs;
+        std::vector<RRMode> modes;
+        std::vector<uint8_t> edid;
+        display::tearfree tearfree = display::tearfree::UNSET;
+        // Of mode_tables: indices into modes, sorted by size, then rate,
+        // then the output's preference.
+        range mode_table;
+    };
+
+    Time timestamp = CurrentTime;
+    Time config_timestamp = CurrentTime;
+    RROutput primary = None;
+    display::vec2<unsigned int> screen_size = {0, 0};
+    display::vec2<unsigned int> screen_size_mm = {0, 0};
+
+    // The EDID and TearFree property atoms and the value atom for each
+    // display::tearfree, or None where the server doesn't know them.
+    Atom edid_property = None;
+    Atom tearfree_property = None;
+    Atom tearfree_values[4] = {None, None, None, None};
+
+    std::vector<mode> modes;
+    // Every distinct mode name once.
+    std::string mode_names;
+    // Every output's mode table, one after the other.
+    std::vector<uint32_t> mode_tables;
+    std::vector<crtc> crtcs;
+    std::vector<output> outputs;
+
+    snapshot() {};
+    // Uses the server's current resources unless `probe` is set or they
+    // look stale, in which case the server probes every connector first.
+    explicit snapshot(session &sess, bool probe = false);
+
+    // Re-fetches the given outputs along with the current mode list,
+    // without asking the server to probe connectors.
+    void refresh(session &sess, const std::vector<RROutput> &output_ids);
+
+    // Rebuilds the mode lookups and every output's mode table; needed
+    // whenever modes or outputs are replaced.
+    void index_modes();
+
+    // Appends a mode, sharing its name with any earlier mode of that name.
+    void add_mode(const mode &mode, std::string_view name);
+
+    std::string_view name(const mode &mode) const
+    {
+        return std::string_view(mode_names)
+            .substr(mode.name.begin, mode.name.size);
+    }
+
+    std::span<const uint32_t> mode_table(const output &output) const
+    {
+        return std::span<const uint32_t>(mode_tables)
+            .subspan(output.mode_table.begin, output.mode_table.size);
+    }
+
+    const mode *find_mode(RRMode mode_id) const;
+    const crtc *find_crtc(RRCrtc crtc_id) const;
+    crtc *find_crtc(RRCrtc crtc_id);
+    const output *find_output(RROutput output_id) const;
+    output *find_output(RROutput output_id);
+
+  private:
+    std::unordered_map<RRMode, size_t> mode_ids;
 };
 
-class output_id
-{
-    RROutput contents;
+// The output as the rest of dman sees it, filled into `output` so it
+// allocates from wherever `output` does.
+void to_output(const snapshot &snapshot,
+               const snapshot::output &info,
+               display::output &output);
 
-  public:
-    output_id(session &sess,
-              screen_resources &resources,
-              uint32_t output_index);
-    operator RROutput() const;
-};
-
-class output_info
+// Keeps a snapshot current from RandR notify events, so a hotplug only
+// costs re-fetching the outputs that changed.
+class watcher
 {
-    XRROutputInfo *contents;
-
-  public:
-    output_info(session &sess,
-                screen_resources &resources,
-                const output_id &output);
-    ~output_info();
-
-    XRROutputInfo *operator->() const;
-
-    output_info(const output_info &) = delete;
-    output_info &operator=(const output_info &) = delete;
-};
+    session &sess;
+    snapshot &current;
+    std::vector<RROutput> dirty;
 
-class crtc_info
-{
-    XRRCrtcInfo *contents;
+    void handle(XEvent &event);
 
   public:
-    crtc_info(session &sess, screen_resources &resources, RRCrtc crtc);
-    ~crtc_info();
+    watcher(session &sess, snapshot &current);
 
-    XRRCrtcInfo *operator->() const;
-    operator bool() const;
+    // Blocks until a burst of events has arrived and gone quiet for
+    // `settle_ms`, then brings the snapshot up to date.
+    void wait(int settle_ms);
 };
 
-class device_info
+struct crtc_config
 {
-    XDeviceInfo *contents;
-    int ndevices;
-
-  public:
-    explicit device_info(session &sess);
-    ~device_info();
-
-    XDeviceInfo *operator[](const std::string &name) const;
+    RRCrtc crtc;
+    int x = 0;
+    int y = 0;
+    RRMode mode = None;
+    Rotation rotation = RR_Rotate_0;
+    std::vector<RROutput> outputs;
+
+    // Extent on the screen once rotated, used to order the commit.
+    unsigned int width = 0;
+    unsigned int height = 0;
 };
 
-class xi_device_info
+// The complete RandR state a commit should leave behind. CRTCs that aren't
+// listed keep their current configuration; a config with mode None
+// disables its CRTC.
+struct layout
 {
-    XIDeviceInfo *contents;
-
-  public:
-    xi_device_info(session &sess, XID device_id);
-    ~xi_device_info();
-
-    XIDeviceInfo *operator[](const std::string &name) const;
-    XIDeviceInfo *operator->() const;
-
-    display::vec2<uint32_t> get_tablet_dimensions() const;
-    std::string get_name() const;
+    std::vector<crtc_config> crtcs;
+    display::vec2<unsigned int> screen_size = {0, 0};
+    display::vec2<unsigned int> screen_size_mm = {0, 0};
+    RROutput primary = None;
+    std::vector<std::pair<RROutput, display::tearfree>> tearfree;
+
+    bool empty() const;
+    std::string describe(const snapshot &before) const;
 };
 
-class x_device
+// Reduces a layout to the requests that actually change something in the
+// given snapshot, so re-applying the running layout issues no modesets.
+layout diff(const snapshot &before, const layout &target);
+
+// A CRTC for each output out of those the server says can drive it, found
+// by bipartite matching over every output's possible CRTCs. Outputs keep
+// the CRTC they have unless another output can't be placed otherwise;
+// None marks those no assignment can fit.
+std::vector<RRCrtc> assign_crtcs(const snapshot &snapshot,
+                                 const std::vector<RROutput> &outputs);
+
+// Adds a disable for every CRTC that's on but unused by the layout, such
+// as those of outputs left out or moved to another CRTC.
+void disable_unused_crtcs(const snapshot &snapshot, layout &layout);
+
+// Applies a layout under a server grab as one batch of requests, ordered
+// so that the screen always contains every enabled CRTC: CRTCs that won't
+// fit are disabled, the screen is resized, then the rest are enabled. If
+// any request fails, the snapshot the transaction was created from is
+// restored and the failure is rethrown.
+class transaction
 {
-    XDevice *contents;
-    Display *display;
+    session &sess;
+    const snapshot &before;
 
   public:
-    x_device(session &sess, XDeviceInfo *device_info);
-    ~x_device();
-
-    XDevice *operator->() const;
-
-    bool set_coodinate_transformation_matrix(const float matrix[3][3]);
+    transaction(session &sess, const snapshot &before);
+    // Returns the number of requests sent.
+    size_t commit(const layout &target);
 };
 
-class crtc
+// The number of requests committing `target` over `before` would send.
+size_t count_requests(const snapshot &before, const layout &target);
+
+// Target layouts compiled from wanted states, kept on disk so applying a
+// profile again on unchanged hardware skips matching EDIDs, modes and
+// CRTCs. Nothing is cached without a cache directory, or while recording or
+// replaying a capture.
+class plan_cache
 {
-    session &sess;
-    screen_resources &resources;
-    RRCrtc contents;
+    std::string path;
 
   public:
-    crtc(session &sess, screen_resources &resources, RRCrtc crtc);
-    crtc(session &sess, screen_resources &resources);
-    operator RRCrtc() const;
-    void set_config(int x,
-                    int y,
-                    RRMode mode,
-                    Rotation rotation,
-                    unsigned int output_index,
-                    int noutputs);
-    void clear();
+    explicit plan_cache(const module::options &options);
+
+    // Covers the wanted states, the server's config timestamp, which
+    // display is on which output and which CRTC drives which output.
+    static digest::sha256 key(const digest::map<display::state> &outputs,
+                              const snapshot &snapshot);
+
+    // The layout stored under `key` if it still applies to `snapshot`, with
+    // the CRTCs of the outputs it leaves out disabled.
+    std::optional<layout> load(const digest::sha256 &key,
+                               const snapshot &snapshot) const;
+    void store(const digest::sha256 &key, const layout &layout) const;
 };
 
 } // namespace x11
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "../../src/x11.hpp"
+#include <iostream>
+
+// assign_crtcs only reads the snapshot, so these build one by hand: no X
+// server is needed.
+
+static int failures = 0;
+
+static void check(const char *what,
+                  const std::vector<RRCrtc> &got,
+                  const std::vector<RRCrtc> &expected)
+{
+    if (got == expected)
+        return;
+
+    std::cerr << "Failed: " << what << ": got";
+    for (RRCrtc crtc : got)
+        std::cerr << " " << crtc;
+    std::cerr << ", expected";
+    for (RRCrtc crtc : expected)
+        std::cerr << " " << crtc;
+    std::cerr << std::endl;
+    ++failures;
+}
+
+static constexpr RRMode mode_id = 0x100;
+
+static void add_crtc(x11::snapshot &snapshot,
+                     RRCrtc id,
+                     std::vector<RROutput> outputs = {})
+{
+    snapshot.crtcs.push_back(x11::snapshot::crtc{
+        .id = id,
+        .mode = outputs.empty() ? None : mode_id,
+        .rotation = RR_Rotate_0,
+        .outputs = std::move(outputs),
+    });
+}
+
+static void add_output(x11::snapshot &snapshot,
+                       RROutput id,
+                       RRCrtc current,
+                       std::vector<RRCrtc> possible)
+{
+    snapshot.outputs.push_back(x11::snapshot::output{
+        .id = id,
+        .name = "DP-" + std::to_string(id),
+        .crtc = current,
+        .connection = RR_Connected,
+        .crtcs = std::move(possible),
+        .modes = {mode_id},
+    });
+}
+
+static void test_keeps_own_crtc()
+{
+    // Output 1 is on CRTC 11, though 10 is listed first and idle.
+    x11::snapshot snapshot;
+    add_crtc(snapshot, 10);
+    add_crtc(snapshot, 11, {1});
+    add_output(snapshot, 1, 11, {10, 11});
+    add_output(snapshot, 2, None, {10, 11});
+
+    check("keeps its own CRTC",
+          x11::assign_crtcs(snapshot, {1, 2}),
+          {11, 10});
+    check("keeps its own CRTC, other order",
+          x11::assign_crtcs(snapshot, {2, 1}),
+          {10, 11});
+}
+
+static void test_augmenting_path()
+{
+    // Output 2 can only use CRTC 10, which output 1 has now; output 1 moves
+    // to 11 to make room.
+    x11::snapshot snapshot;
+    add_crtc(snapshot, 10, {1});
+    add_crtc(snapshot, 11);
+    add_output(snapshot, 1, 10, {10, 11});
+    add_output(snapshot, 2, None, {10});
+
+    check("moved along an augmenting path",
+          x11::assign_crtcs(snapshot, {1, 2}),
+          {11, 10});
+
+    // Three deep: 3 needs 12, which 2 has, which can only move to 11,
+    // which 1 has, which can move to 10.
+    x11::snapshot chain;
+    add_crtc(chain, 10);
+    add_crtc(chain, 11, {1});
+    add_crtc(chain, 12, {2});
+    add_output(chain, 1, 11, {11, 10});
+    add_output(chain, 2, 12, {12, 11});
+    add_output(chain, 3, None, {12});
+
+    check("moved along a longer path",
+          x11::assign_crtcs(chain, {1, 2, 3}),
+          {10, 11, 12});
+}
+
+static void test_unplaceable()
+{
+    x11::snapshot snapshot;
+    add_crtc(snapshot, 10, {1});
+    add_output(snapshot, 1, 10, {10});
+    add_output(snapshot, 2, None, {10});
+    add_output(snapshot, 3, None, {});
+
+    check("no CRTC left",
+          x11::assign_crtcs(snapshot, {1, 2}),
+          {10, None});
+    check("no possible CRTC",
+          x11::assign_crtcs(snapshot, {3, 1}),
+          {None, 10});
+    check("unknown output",
+          x11::assign_crtcs(snapshot, {99, 1}),
+          {None, 10});
+}
+
+static void test_clone()
+{
+    // Outputs 1 and 2 share CRTC 10 as clones; only one can keep it.
+    x11::snapshot snapshot;
+    add_crtc(snapshot, 10, {1, 2});
+    add_crtc(snapshot, 11);
+    add_output(snapshot, 1, 10, {10, 11});
+    add_output(snapshot, 2, 10, {10, 11});
+
+    check("clones split", x11::assign_crtcs(snapshot, {1, 2}), {10, 11});
+
+    // When the second can only use the shared CRTC, the first moves off.
+    x11::snapshot pinned;
+    add_crtc(pinned, 10, {1, 2});
+    add_crtc(pinned, 11);
+    add_output(pinned, 1, 10, {10, 11});
+    add_output(pinned, 2, 10, {10});
+
+    check("clone moved for one pinned to the shared CRTC",
+          x11::assign_crtcs(pinned, {1, 2}),
+          {11, 10});
+}
+
+int main()
+{
+    test_keeps_own_crtc();
+    test_augmenting_path();
+    test_unplaceable();
+    test_clone();
+
+    return failures == 0 ? 0 : 1;
+}
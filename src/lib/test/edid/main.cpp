@@ -0,0 +1,444 @@
+#include <dman/edid.hpp>
+#include <X11/extensions/randr.h>
+#include <iostream>
+#include <vector>
+
+// EDIDs come straight from displays, so the decoder is run over fixtures
+// built here: well formed ones, and ones cut short or claiming more blocks
+// than they have.
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        std::cerr << "Failed: " << what << std::endl;
+        ++failures;
+    }
+}
+
+using bytes = std::vector<uint8_t>;
+
+struct timing_fields
+{
+    uint32_t clock; // In the descriptor's units.
+    uint16_t h_active, h_blank, h_sync_offset, h_sync_width;
+    uint16_t v_active, v_blank, v_sync_offset, v_sync_width;
+};
+
+// 1920x1080 at 60 Hz, as CEA-861 defines it.
+static const timing_fields full_hd = {
+    14850, 1920, 280, 88, 44, 1080, 45, 4, 5};
+
+// 1920x1080 interlaced, one field of it.
+static const timing_fields full_hd_interlaced = {
+    7425, 1920, 280, 88, 44, 540, 22, 2, 5};
+
+// 2560x1440 at 144 Hz, with reduced blanking.
+static const timing_fields qhd = {
+    58600, 2560, 160, 48, 32, 1440, 62, 3, 5};
+
+static void put_le16(uint8_t *p, unsigned int value)
+{
+    p[0] = value & 0xFF;
+    p[1] = value >> 8 & 0xFF;
+}
+
+static void put_le24(uint8_t *p, unsigned int value)
+{
+    put_le16(p, value);
+    p[2] = value >> 16 & 0xFF;
+}
+
+static void put_descriptor_timing(uint8_t *p,
+                                  const timing_fields &t,
+                                  uint8_t flags)
+{
+    put_le16(p, t.clock);
+    p[2] = t.h_active & 0xFF;
+    p[3] = t.h_blank & 0xFF;
+    p[4] = (t.h_active >> 8) << 4 | t.h_blank >> 8;
+    p[5] = t.v_active & 0xFF;
+    p[6] = t.v_blank & 0xFF;
+    p[7] = (t.v_active >> 8) << 4 | t.v_blank >> 8;
+    p[8] = t.h_sync_offset & 0xFF;
+    p[9] = t.h_sync_width & 0xFF;
+    p[10] = (t.v_sync_offset & 0x0F) << 4 | (t.v_sync_width & 0x0F);
+    p[11] = (t.h_sync_offset >> 8) << 6 | (t.h_sync_width >> 8) << 4 |
+            (t.v_sync_offset >> 4) << 2 | t.v_sync_width >> 4;
+    p[17] = flags;
+}
+
+static void put_checksum(uint8_t *block)
+{
+    uint8_t sum = 0;
+    for (int i = 0; i < 127; ++i)
+        sum += block[i];
+    block[127] = -sum;
+}
+
+// A base block for DEL product 0x4321, serial 0x12345678, named "Test
+// Panel", with full_hd as its first detailed timing and a 48-144 Hz range.
+static bytes base_block(uint8_t extensions, uint8_t first_flags = 0x1E)
+{
+    bytes result(128);
+    uint8_t *b = result.data();
+
+    const uint8_t header[8] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+    std::copy(header, header + 8, b);
+
+    uint16_t id =
+        ('D' - 'A' + 1) << 10 | ('E' - 'A' + 1) << 5 | ('L' - 'A' + 1);
+    b[8] = id >> 8;
+    b[9] = id & 0xFF;
+    put_le16(b + 10, 0x4321);
+    put_le16(b + 12, 0x5678);
+    put_le16(b + 14, 0x1234);
+    b[18] = 1;
+    b[19] = 4;
+    // Continuous frequencies.
+    b[0x18] = 0x01;
+
+    put_descriptor_timing(b + 54, full_hd, first_flags);
+
+    uint8_t *name = b + 72;
+    name[3] = 0xFC;
+    const char text[] = "Test Panel\n  ";
+    std::copy(text, text + 13, name + 5);
+
+    uint8_t *range = b + 90;
+    range[3] = 0xFD;
+    range[5] = 48;
+    range[6] = 144;
+    range[7] = 30;
+    range[8] = 160;
+    range[9] = 60;
+
+    // The last descriptor is a dummy.
+    b[108 + 3] = 0x10;
+
+    b[126] = extensions;
+    put_checksum(b);
+    return result;
+}
+
+// A CTA-861 extension with an HDMI Forum block declaring 40-120 Hz VRR,
+// then qhd and an interlaced 1080 line timing.
+static bytes cta_block()
+{
+    bytes result(128);
+    uint8_t *b = result.data();
+    b[0] = 0x02;
+    b[1] = 3;
+
+    uint8_t *db = b + 4;
+    db[0] = 3 << 5 | 10;
+    db[1] = 0xD8;
+    db[2] = 0x5D;
+    db[3] = 0xC4;
+    db[4] = 1;
+    db[9] = 40;
+    db[10] = 120;
+
+    b[2] = 4 + 11;
+    put_descriptor_timing(b + 15, qhd, 0x1E);
+    put_descriptor_timing(b + 33, full_hd_interlaced, 0x80 | 0x1E);
+
+    put_checksum(b);
+    return result;
+}
+
+static void put_displayid_timing(uint8_t *p,
+                                 const timing_fields &t,
+                                 bool preferred,
+                                 bool positive)
+{
+    put_le24(p, t.clock - 1);
+    p[3] = preferred ? 0x80 : 0;
+    put_le16(p + 4, t.h_active - 1);
+    put_le16(p + 6, t.h_blank - 1);
+    put_le16(p + 8, (t.h_sync_offset - 1) | (positive ? 0x8000 : 0));
+    put_le16(p + 10, t.h_sync_width - 1);
+    put_le16(p + 12, t.v_active - 1);
+    put_le16(p + 14, t.v_blank - 1);
+    put_le16(p + 16, (t.v_sync_offset - 1) | (positive ? 0x8000 : 0));
+    put_le16(p + 18, t.v_sync_width - 1);
+}
+
+// A DisplayID extension with display parameters for a 3840x2160 panel, a
+// type I timing for full_hd and a preferred type VII timing for qhd.
+static bytes displayid_block()
+{
+    bytes result(128);
+    uint8_t *b = result.data();
+    b[0] = 0x70;
+    b[1] = 0x12;
+
+    size_t at = 5;
+
+    b[at] = 0x01;
+    b[at + 2] = 12;
+    put_le16(b + at + 3 + 4, 3840);
+    put_le16(b + at + 3 + 6, 2160);
+    at += 3 + 12;
+
+    b[at] = 0x03;
+    b[at + 2] = 20;
+    put_displayid_timing(b + at + 3, full_hd, false, false);
+    at += 3 + 20;
+
+    // Type VII clocks are in kHz rather than 10 kHz.
+    timing_fields qhd_khz = qhd;
+    qhd_khz.clock *= 10;
+    b[at] = 0x22;
+    b[at + 2] = 20;
+    put_displayid_timing(b + at + 3, qhd_khz, true, true);
+    at += 3 + 20;
+
+    b[2] = at - 5;
+    put_checksum(b);
+    return result;
+}
+
+static bytes join(std::initializer_list<bytes> blocks)
+{
+    bytes result;
+    for (const bytes &block : blocks)
+        result.insert(result.end(), block.begin(), block.end());
+    return result;
+}
+
+static std::vector<display::detailed_timing> timings(const bytes &edid)
+{
+    std::vector<display::detailed_timing> result;
+    display::edid_view(edid.data(), edid.size())
+        .for_each_timing([&](const display::detailed_timing &timing)
+                         { result.push_back(timing); });
+    return result;
+}
+
+static bool same_size(const display::detailed_timing &timing,
+                      const timing_fields &t)
+{
+    return timing.h_active == t.h_active && timing.v_active == t.v_active &&
+           timing.h_blank == t.h_blank && timing.v_blank == t.v_blank &&
+           timing.h_sync_offset == t.h_sync_offset &&
+           timing.h_sync_width == t.h_sync_width &&
+           timing.v_sync_offset == t.v_sync_offset &&
+           timing.v_sync_width == t.v_sync_width;
+}
+
+static void test_base_block()
+{
+    bytes edid = base_block(0);
+    display::edid_view view(edid.data(), edid.size());
+
+    check(view.valid(), "base: valid");
+    check(view.manufacturer_id() == std::array<char, 3>{'D', 'E', 'L'},
+          "base: manufacturer");
+    check(view.product_code() == 0x4321, "base: product code");
+    check(view.serial_number() == 0x12345678, "base: serial number");
+    check(view.monitor_name() == "Test Panel", "base: monitor name");
+
+    std::optional<display::range_limits> limits = view.limits();
+    check(limits && limits->min_v_rate == 48 && limits->max_v_rate == 144 &&
+              limits->max_pixel_clock == 600000,
+          "base: range limits");
+
+    std::vector<display::detailed_timing> found = timings(edid);
+    check(found.size() == 1, "base: one timing");
+    if (found.size() == 1)
+    {
+        check(same_size(found[0], full_hd) && found[0].preferred &&
+                  found[0].pixel_clock == 148500,
+              "base: first timing");
+
+        display::timing timing = found[0].timing();
+        check(timing.dot_clock == 148500000 && timing.h_total == 2200 &&
+                  timing.v_total == 1125 &&
+                  timing.flags == (RR_HSyncPositive | RR_VSyncPositive),
+              "base: timing as the server derives it");
+    }
+
+    std::optional<display::refresh_range> vrr = view.vrr_range();
+    check(vrr && vrr->min == 48 && vrr->max == 144,
+          "base: continuous frequencies give the VRR range");
+
+    std::optional<display::vec2<unsigned int>> native =
+        view.native_resolution();
+    check(native && native->x == 1920 && native->y == 1080,
+          "base: native resolution from the preferred timing");
+}
+
+static void test_analog_sync()
+{
+    // Analog composite sync, with the polarity bits set anyway.
+    bytes edid = base_block(0, 0x06);
+    display::edid_view view(edid.data(), edid.size());
+
+    std::optional<display::detailed_timing> preferred =
+        view.preferred_timing();
+    check(preferred &&
+              preferred->timing().flags ==
+                  (RR_HSyncPositive | RR_VSyncPositive),
+          "analog: polarities read whatever the sync type");
+
+    edid = base_block(0, 0x00);
+    view = display::edid_view(edid.data(), edid.size());
+    preferred = view.preferred_timing();
+    check(preferred &&
+              preferred->timing().flags ==
+                  (RR_HSyncNegative | RR_VSyncNegative),
+          "analog: clear bits are negative polarities");
+}
+
+static void test_cta()
+{
+    bytes edid = join({base_block(1), cta_block()});
+    display::edid_view view(edid.data(), edid.size());
+
+    std::vector<display::detailed_timing> found = timings(edid);
+    check(found.size() == 3, "cta: base and extension timings");
+    if (found.size() == 3)
+    {
+        check(same_size(found[0], full_hd), "cta: base timing first");
+        check(same_size(found[1], qhd) && !found[1].preferred &&
+                  found[1].pixel_clock == 586000,
+              "cta: first extension timing");
+        check(same_size(found[2], full_hd_interlaced) && found[2].interlaced,
+              "cta: interlaced timing");
+
+        display::timing timing = found[2].timing();
+        check(timing.v_total == 1125 && (timing.flags & RR_Interlace),
+              "cta: interlaced timing doubled into a frame");
+    }
+
+    std::optional<display::refresh_range> vrr = view.vrr_range();
+    check(vrr && vrr->min == 40 && vrr->max == 120,
+          "cta: VRR range from the HDMI Forum block");
+
+    std::optional<display::detailed_timing> preferred =
+        view.preferred_timing();
+    check(preferred && same_size(*preferred, full_hd),
+          "cta: base block's first timing stays preferred");
+}
+
+static void test_displayid()
+{
+    bytes edid = join({base_block(1), displayid_block()});
+    display::edid_view view(edid.data(), edid.size());
+
+    std::vector<display::detailed_timing> found = timings(edid);
+    check(found.size() == 3, "displayid: base and extension timings");
+    if (found.size() == 3)
+    {
+        check(same_size(found[1], full_hd) && found[1].pixel_clock == 148500 &&
+                  !found[1].preferred && !found[1].h_sync_positive,
+              "displayid: type I timing");
+        check(same_size(found[2], qhd) && found[2].pixel_clock == 586000 &&
+                  found[2].preferred && found[2].h_sync_positive &&
+                  found[2].v_sync_positive,
+              "displayid: type VII timing");
+    }
+
+    std::optional<display::vec2<unsigned int>> native =
+        view.native_resolution();
+    check(native && native->x == 3840 && native->y == 2160,
+          "displayid: native resolution from display parameters");
+}
+
+static void test_truncated()
+{
+    // The extension is cut off halfway, so only the base block is read.
+    bytes edid = join({base_block(1), cta_block()});
+    edid.resize(128 + 64);
+    display::edid_view view(edid.data(), edid.size());
+
+    check(view.valid(), "truncated: base block still valid");
+    check(timings(edid).size() == 1, "truncated: extension ignored");
+    std::optional<display::refresh_range> vrr = view.vrr_range();
+    check(vrr && vrr->min == 48 && vrr->max == 144,
+          "truncated: VRR range from the base block, not the extension");
+
+    // A base block cut short is nothing at all.
+    bytes base = base_block(0);
+    base.resize(100);
+    view = display::edid_view(base.data(), base.size());
+    check(!view.valid(), "truncated: partial base block invalid");
+    check(timings(base).empty(), "truncated: partial base block no timings");
+}
+
+static void test_short()
+{
+    for (size_t size : {0, 1, 8, 127})
+    {
+        bytes edid = base_block(0);
+        edid.resize(size);
+        display::edid_view view(edid.data(), edid.size());
+
+        check(!view.valid(), "short: invalid");
+        check(view.manufacturer_id() == std::array<char, 3>{},
+              "short: no manufacturer");
+        check(view.product_code() == 0 && view.serial_number() == 0,
+              "short: no product or serial");
+        check(view.monitor_name().empty(), "short: no name");
+        check(!view.limits(), "short: no limits");
+        check(!view.preferred_timing(), "short: no preferred timing");
+        check(!view.vrr_range(), "short: no VRR range");
+        check(!view.native_resolution(), "short: no native resolution");
+        check(timings(edid).empty(), "short: no timings");
+    }
+
+    display::edid_view empty(nullptr, 0);
+    check(!empty.valid() && !empty.preferred_timing(), "short: null view");
+}
+
+static void test_bad_header()
+{
+    bytes zeroed(128, 0);
+    bytes corrupt = base_block(0);
+    corrupt[3] = 0x00;
+
+    for (const bytes &edid : {zeroed, corrupt})
+    {
+        display::edid_view view(edid.data(), edid.size());
+
+        check(!view.valid(), "bad header: invalid");
+        check(view.manufacturer_id() == std::array<char, 3>{},
+              "bad header: no manufacturer");
+        check(view.product_code() == 0 && view.serial_number() == 0,
+              "bad header: no product or serial");
+        check(!view.preferred_timing(), "bad header: no preferred timing");
+        check(timings(edid).empty(), "bad header: no timings");
+    }
+}
+
+static void test_extension_count()
+{
+    // Claims 255 extensions; only the one present is read.
+    bytes edid = join({base_block(255), cta_block()});
+    display::edid_view view(edid.data(), edid.size());
+
+    check(timings(edid).size() == 3, "extension count: present ones read");
+    std::optional<display::refresh_range> vrr = view.vrr_range();
+    check(vrr && vrr->min == 40, "extension count: CTA block still found");
+    check(view.native_resolution().has_value(),
+          "extension count: no read past the buffer");
+}
+
+int main()
+{
+    test_base_block();
+    test_analog_sync();
+    test_cta();
+    test_displayid();
+    test_truncated();
+    test_short();
+    test_bad_header();
+    test_extension_count();
+
+    if (failures)
+        std::cerr << failures << " checks failed." << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include "../../src/sha256.hpp"
+#include <dman/digest.hpp>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Configs are keyed by these digests, so they must match what libgcrypt
+// produced byte for byte, whichever compression function runs.
+
+struct vector
+{
+    std::string input;
+    const char *expected;
+};
+
+static const vector vectors[] = {
+    // FIPS 180-4 examples.
+    {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {std::string(1000000, 'a'),
+     "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+    // Either side of the lengths where the padding spills into a second
+    // block (56) and where the input fills whole blocks (64, 128).
+    {std::string(55, 'a'),
+     "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318"},
+    {std::string(56, 'a'),
+     "b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a"},
+    {std::string(57, 'a'),
+     "f13b2d724659eb3bf47f2dd6af1accc87b81f09f59f2b75e5c0bed6589dfe8c6"},
+    {std::string(63, 'a'),
+     "7d3e74a05d7db15bce4ad9ec0658ea98e3f06eeecf16b4c6fff2da457ddc2f34"},
+    {std::string(64, 'a'),
+     "ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb"},
+    {std::string(65, 'a'),
+     "635361c48bb9eab14198e76ea8ab7f1a41685d6ad62aa9146d301d4f17eb0ae0"},
+    {std::string(119, 'a'),
+     "31eba51c313a5c08226adf18d4a359cfdfd8d2e816b13f4af952f7ea6584dcfb"},
+    {std::string(120, 'a'),
+     "2f3d335432c70b580af0e8e1b3674a7c020d683aa5f73aaaedfdc55af904c21c"},
+    {std::string(128, 'a'),
+     "6836cf13bac400e9105071cd6af47084dfacad4e5e302c94bfed24e013afb73e"},
+};
+
+static int check_vectors()
+{
+    int failures = 0;
+
+    for (const vector &v : vectors)
+    {
+        std::string hex = digest::sha256(v.input.data(), v.input.size()).hex();
+        if (hex != v.expected)
+        {
+            std::cerr << sha2::implementation() << ": " << v.input.size()
+                      << " bytes hashed to " << hex << ", expected "
+                      << v.expected << std::endl;
+            ++failures;
+        }
+    }
+
+    return failures;
+}
+
+int main()
+{
+    int failures = 0;
+
+    for (const char *name : {"portable", "sha-ni"})
+    {
+        if (!sha2::use_implementation(name))
+        {
+            std::cout << name << ": not supported here; skipped." << std::endl;
+            continue;
+        }
+
+        std::cout << name << std::endl;
+        failures += check_vectors();
+    }
+
+    // Every length through a few blocks hashes the same both ways.
+    std::string input;
+    for (size_t size = 0; size <= 200; ++size)
+    {
+        uint8_t portable[32], chosen[32];
+
+        sha2::use_implementation("portable");
+        sha2::hash256(input.data(), input.size(), portable);
+
+        if (sha2::use_implementation("sha-ni"))
+        {
+            sha2::hash256(input.data(), input.size(), chosen);
+            if (std::memcmp(portable, chosen, sizeof(chosen)) != 0)
+            {
+                std::cerr << "Implementations differ at " << size << " bytes."
+                          << std::endl;
+                ++failures;
+            }
+        }
+
+        input.push_back((char)(size * 131 + 7));
+    }
+
+    return failures == 0 ? 0 : 1;
+}
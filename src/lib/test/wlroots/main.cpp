@@ -0,0 +1,93 @@
+#include "../../src/wlroots.hpp"
+#include <iostream>
+
+// Needs a running wlroots compositor whose heads are all headless, such as
+// one started with WLR_BACKENDS=headless. Skipped otherwise, since it moves
+// outputs around and a real session's would be left moved if a step
+// failed.
+
+static bool moved_to(wlroots::session &sess,
+                     const digest::sha256 &edid,
+                     unsigned int x)
+{
+    std::pmr::vector<display::output> outputs;
+    sess.outputs(outputs);
+
+    for (const display::output &output : outputs)
+    {
+        if (output.edid.digest == edid)
+            return output.position.x == x;
+    }
+    return false;
+}
+
+int main()
+{
+    std::unique_ptr<wlroots::session> sess = wlroots::session::connect();
+
+    if (!sess)
+    {
+        std::cout << "No compositor with output management; skipping."
+                  << std::endl;
+        return 77;
+    }
+
+    for (const std::unique_ptr<wlroots::head> &head : sess->heads)
+    {
+        if (!head->name.starts_with("HEADLESS-"))
+        {
+            std::cout << "Output " << head->name
+                      << " isn't headless; skipping." << std::endl;
+            return 77;
+        }
+    }
+
+    digest::map<display::state> layout;
+    const display::output *moved = nullptr;
+
+    std::pmr::vector<display::output> outputs;
+    sess->outputs(outputs);
+    for (const display::output &output : outputs)
+    {
+        std::cout << "Output: " << output.name << " " << output.edid.digest.hex()
+                  << (output.is_active ? " active" : "") << std::endl;
+        layout[output.edid.digest] = output;
+        if (output.is_active && !moved)
+            moved = &output;
+    }
+
+    // The running layout plans to nothing and applies cleanly.
+    std::string plan = sess->plan(layout);
+    if (!plan.empty())
+    {
+        std::cerr << "Unexpected changes:\n" << plan;
+        return 1;
+    }
+    sess->apply(layout);
+
+    if (!moved)
+        return 0;
+
+    // Move one output and put it back.
+    display::state &state = layout[moved->edid.digest];
+    unsigned int x = state.position.x;
+
+    state.position.x = x + 100;
+    std::cout << sess->plan(layout);
+    sess->apply(layout);
+    if (!moved_to(*sess, moved->edid.digest, x + 100))
+    {
+        std::cerr << "Output wasn't moved." << std::endl;
+        return 1;
+    }
+
+    state.position.x = x;
+    sess->apply(layout);
+    if (!moved_to(*sess, moved->edid.digest, x))
+    {
+        std::cerr << "Output wasn't moved back." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
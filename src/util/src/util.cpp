@@ -6,8 +6,13 @@
 #include <cmath>
 #include <dman/config.hpp>
 #include <dman/help.hpp>
+#include <dman/stats.hpp>
+#include <filesystem>
+#include <memory>
 #include <set>
-#include <unordered_set>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 
 void print_usage(const char *name)
 {
@@ -40,17 +45,39 @@ std::string read_file(const std::string &file_path)
     return ss.str();
 }
 
+// Writes everything with as few write calls as the kernel allows, usually
+// one.
+bool write_all(int fd, const std::string &content)
+{
+    size_t written = 0;
+    while (written < content.size())
+    {
+        ssize_t result =
+            write(fd, content.data() + written, content.size() - written);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        written += result;
+    }
+    return true;
+}
+
 void write_file(const std::string &file_path, const std::string &content)
 {
     if (file_path == "-")
     {
-        std::cout << content;
+        std::cout.flush();
+        if (!write_all(STDOUT_FILENO, content))
+            throw std::runtime_error("Failed to write to standard output.");
         return;
     }
-    std::ofstream file_stream(file_path, std::ios::out | std::ios::binary);
-    if (!file_stream)
+    int fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
         throw std::runtime_error("Failed to open file: " + file_path);
-    file_stream << content;
+    bool ok = write_all(fd, content);
+    if (close(fd) != 0 || !ok)
+        throw std::runtime_error("Failed to write file: " + file_path);
 }
 
 std::string read_stdin_line()
@@ -67,7 +94,34 @@ std::string get_argument_name(std::string arg)
     return arg;
 }
 
-int main(int argc, char *argv[])
+std::vector<digest::sha256>
+get_connected_edids(std::span<const display::output> outputs)
+{
+    std::vector<digest::sha256> result;
+    for (const display::output &output : outputs)
+    {
+        if (output.is_connected)
+            result.push_back(output.edid.digest);
+    }
+    return result;
+}
+
+digest::set get_connected_edid_set(std::span<const display::output> outputs)
+{
+    std::vector<digest::sha256> edids = get_connected_edids(outputs);
+    return digest::set(edids.begin(), edids.end());
+}
+
+// Set by --stats. Printed by main rather than at exit, so runs that end in
+// an exception still report where their time went.
+static bool show_stats = false;
+
+void print_stats()
+{
+    std::cerr << stats::json() << std::endl;
+}
+
+static int run(int argc, char *argv[])
 {
     if (argc < 2)
     {
@@ -84,6 +138,14 @@ int main(int argc, char *argv[])
         {"disable", required_argument, 0, 'd'},
         {"list-config-outputs", required_argument, 0, 'c'},
         {"list-active-outputs", no_argument, 0, 'a'},
+        {"plan", no_argument, 0, 'p'},
+        {"profiles", required_argument, 0, 'P'},
+        {"add-profile", required_argument, 0, 'A'},
+        {"daemon", no_argument, 0, 'D'},
+        {"record", required_argument, 0, 'r'},
+        {"replay", required_argument, 0, 'R'},
+        {"stats", no_argument, 0, 's'},
+        {"probe", no_argument, 0, 'x'},
         {0, 0, 0, 0},
     };
 
@@ -93,12 +155,15 @@ int main(int argc, char *argv[])
     std::vector<std::string> enable_outputs;
     std::vector<std::string> disable_outputs;
     std::vector<std::string> list_config_outputs;
+    std::string profiles_file;
+    std::vector<std::string> add_profiles;
+    bool daemon = false;
     bool list_active_outputs = false;
+    bool plan_only = false;
     int option_index = 0;
     int c;
-    while (
-        (c = getopt_long(argc, argv, "hi:o:", long_options, &option_index)) !=
-        -1)
+    while ((c = getopt_long(argc, argv, "hi:o:t:e:d:c:apP:A:Dr:R:sx",
+                            long_options, &option_index)) != -1)
     {
         switch (c)
         {
@@ -126,12 +191,81 @@ int main(int argc, char *argv[])
         case 'c':
             list_config_outputs.emplace_back(get_argument_name(optarg));
             break;
+        case 'p':
+            plan_only = true;
+            break;
+        case 'P':
+            profiles_file = optarg;
+            break;
+        case 'A':
+            add_profiles.emplace_back(optarg);
+            break;
+        case 'D':
+            daemon = true;
+            break;
+        case 'r':
+            display::record_session(optarg);
+            break;
+        case 'R':
+            display::replay_session(optarg);
+            break;
+        case 's':
+            show_stats = true;
+            break;
+        case 'x':
+            display::probe_hardware(true);
+            break;
         default:
             print_usage(argv[0]);
             return 1;
         }
     }
 
+    if ((!add_profiles.empty() || daemon) && profiles_file.empty())
+    {
+        throw std::runtime_error(
+            "A profile store must be specified with --profiles when adding "
+            "profiles or running as a daemon.");
+    }
+
+    if (!add_profiles.empty())
+    {
+        std::unique_ptr<util::display::profiles> store =
+            std::filesystem::exists(profiles_file)
+                ? std::make_unique<util::display::profiles>(profiles_file)
+                : std::make_unique<util::display::profiles>();
+
+        for (const std::string &file : add_profiles)
+            store->add(util::display::config(read_file(file)));
+
+        store->save(profiles_file);
+
+        return 0;
+    }
+
+    if (daemon)
+    {
+        util::display::profiles store(profiles_file);
+
+        display::watch_outputs(
+            [&](const std::vector<digest::sha256> &connected_edids)
+                -> std::optional<digest::map<display::state>> {
+                std::optional<util::display::config> profile =
+                    store.match(connected_edids);
+                if (!profile)
+                    return std::nullopt;
+                return profile->outputs;
+            });
+    }
+
+    // Opened on first use, then shared by every query and apply below.
+    std::optional<display::context> opened;
+    auto context = [&]() -> display::context & {
+        if (!opened)
+            opened.emplace();
+        return *opened;
+    };
+
     if (!toggle_outputs.empty() || !enable_outputs.empty() ||
         !disable_outputs.empty())
     {
@@ -142,8 +276,10 @@ int main(int argc, char *argv[])
                 "outputs.");
         }
 
-        util::display::config cfg_input(read_file(input_file));
-        util::display::config cfg_current(display::get_outputs());
+        std::span<const display::output> outputs = context().outputs();
+        util::display::config cfg_input(read_file(input_file),
+                                        get_connected_edid_set(outputs));
+        util::display::config cfg_current(outputs);
         cfg_current.set_reference(cfg_input);
 
         for (const auto &name : toggle_outputs)
@@ -161,7 +297,10 @@ int main(int argc, char *argv[])
 
         std::cerr << (std::string)cfg_current;
 
-        display::set_outputs(cfg_current);
+        if (plan_only)
+            std::cout << context().plan_outputs(cfg_current);
+        else
+            context().set_outputs(cfg_current);
 
         return 0;
     }
@@ -169,28 +308,20 @@ int main(int argc, char *argv[])
     if (list_active_outputs || list_config_outputs.size() > 0)
     {
         std::set<std::string> output_names;
-        std::unordered_set<std::string> output_edids;
+        digest::set output_edids;
 
-        std::vector<display::output> active_outputs = display::get_outputs();
+        std::span<const display::output> active_outputs = context().outputs();
 
-        std::unordered_set<std::string> connected_edids;
-
-        for (const display::output &output : active_outputs)
-        {
-            connected_edids.insert(output.edid.digest.hex());
-        }
+        digest::set connected_edids = get_connected_edid_set(active_outputs);
 
         for (const std::string &file : list_config_outputs)
         {
-            util::display::config cfg_input(read_file(file));
+            util::display::config cfg_input(read_file(file), connected_edids);
             for (const auto &[edid, state] : cfg_input.outputs)
             {
                 if (output_edids.find(edid) != output_edids.end())
                     continue;
 
-                if (connected_edids.find(edid) == connected_edids.end())
-                    continue;
-
                 output_names.insert(cfg_input.get_name(edid));
                 output_edids.insert(edid);
             }
@@ -200,7 +331,7 @@ int main(int argc, char *argv[])
         {
             for (const display::output &output : active_outputs)
             {
-                std::string edid = output.edid.digest.hex();
+                const digest::sha256 &edid = output.edid.digest;
 
                 if (!output.is_active)
                     continue;
@@ -208,7 +339,7 @@ int main(int argc, char *argv[])
                 if (output_edids.find(edid) != output_edids.end())
                     continue;
 
-                output_names.insert(output.edid.name);
+                output_names.insert(std::string(output.edid.name));
                 output_edids.insert(edid);
             }
         }
@@ -221,17 +352,59 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    if (!profiles_file.empty() && input_file.empty())
+    {
+        util::display::profiles store(profiles_file);
+        std::optional<util::display::config> profile =
+            store.match(get_connected_edids(context().outputs()));
+
+        if (!profile)
+        {
+            std::cerr << "No profile matches the connected displays."
+                      << std::endl;
+            return 1;
+        }
+
+        if (plan_only)
+            std::cout << context().plan_outputs(*profile);
+        else
+            context().set_outputs(*profile);
+    }
+
     if (!input_file.empty())
     {
-        util::display::config cfg(read_file(input_file));
-        display::set_outputs(cfg);
+        util::display::config cfg(
+            read_file(input_file),
+            get_connected_edid_set(context().outputs()));
+        if (plan_only)
+            std::cout << context().plan_outputs(cfg);
+        else
+            context().set_outputs(cfg);
     }
 
     if (!output_file.empty())
     {
-        std::vector<display::output> outputs = display::get_outputs();
-        util::display::config cfg(outputs);
+        util::display::config cfg(context().outputs());
         write_file(output_file, (std::string)cfg);
     }
     return 0;
 }
+
+int main(int argc, char *argv[])
+{
+    int status;
+    try
+    {
+        status = run(argc, argv);
+    }
+    catch (...)
+    {
+        if (show_stats)
+            print_stats();
+        throw;
+    }
+
+    if (show_stats)
+        print_stats();
+    return status;
+}